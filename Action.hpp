@@ -1,7 +1,9 @@
 #pragma once
 #include <expected>
 #include "basic_types.hpp"
+#include <limits>
 #include <sstream>
+#include "FieldDecode.hpp"
 
 namespace hft {
 
@@ -9,14 +11,41 @@ enum class ActionType
 {
   Place,
   Cancel,
+  MassCancel,
   Print,
+  Hash,
+  Stats,
+  Memory,
+  Delta,
+};
+
+// What a MassCancel action covers
+enum class CancelScope
+{
+  Book,
+  Symbol,
+  Side,
 };
 
 std::ostream& operator<<(std::ostream& os, const ActionType& o) {
   switch (o) {
     case ActionType::Place: os << "Place"; break;
     case ActionType::Cancel: os << "Cancel"; break;
+    case ActionType::MassCancel: os << "MassCancel"; break;
     case ActionType::Print: os << "Print"; break;
+    case ActionType::Hash: os << "Hash"; break;
+    case ActionType::Stats: os << "Stats"; break;
+    case ActionType::Memory: os << "Memory"; break;
+    case ActionType::Delta: os << "Delta"; break;
+  }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const CancelScope& o) {
+  switch (o) {
+    case CancelScope::Book: os << "Book"; break;
+    case CancelScope::Symbol: os << "Symbol"; break;
+    case CancelScope::Side: os << "Side"; break;
   }
   return os;
 }
@@ -25,52 +54,151 @@ struct Action
 {
   ActionType type;
   Order order;
+  CancelScope scope{CancelScope::Book};  // MassCancel only
   Action(std::string const & s);
+
+ private:
+  static auto parseSide_(std::string_view s) -> Side;
+  static auto parseTimeInForce_(std::string_view s) -> TimeInForce;
+  static auto nextField_(std::string_view & s) -> std::string_view;
+  static auto parseOrderID_(std::string_view s) -> OrderID;
+  static auto parseQuantity_(std::string_view s) -> Quantity;
 };
 
 Action::Action(std::string const & s)
 {
-  std::stringstream ss(s);
-  std::string type_str, symbol_str, side_str, quantity_str;
-  ss >> type_str;
+  std::string_view rest(s);
+  auto type_str = nextField_(rest);
 
   if (type_str == "O") {
     type = ActionType::Place;
-    ss >> order.id;
-    ss >> order.symbol;
-    ss >> side_str;
-    // std::cout << "order.symbol = '" << order.symbol <<"'" << std::endl;
-    if (side_str.size() != 1) {
-      throw std::invalid_argument("Invalid side");
-    }
-    if (side_str[0] == 'B') {
-      order.side = Side::Buy;
-    }
-    else if (side_str[0] == 'S') {
-      order.side = Side::Sell;
+    order.id = parseOrderID_(nextField_(rest));
+    order.symbol = Symbol(nextField_(rest));
+    order.side = parseSide_(nextField_(rest));
+    order.quantity = parseQuantity_(nextField_(rest));
+    order.price = Price(nextField_(rest));
+    if (auto tif_str = nextField_(rest); !tif_str.empty()) {
+      order.tif = parseTimeInForce_(tif_str);
     }
-    else {
-      throw std::invalid_argument("Invalid side");
+  }
+  else if (type_str == "S") {
+    // Stop order, or stop-limit order when a limit price follows the stop price
+    type = ActionType::Place;
+    order.id = parseOrderID_(nextField_(rest));
+    order.symbol = Symbol(nextField_(rest));
+    order.side = parseSide_(nextField_(rest));
+    order.quantity = parseQuantity_(nextField_(rest));
+    order.stop_price = Price(nextField_(rest));
+    order.type = OrderType::Stop;
+    if (auto price_str = nextField_(rest); !price_str.empty()) {
+      order.type = OrderType::StopLimit;
+      order.price = Price(price_str);
     }
-    ss >> order.quantity;
-    ss >> order.price;
   }
   else if (type_str == "X") {
     type = ActionType::Cancel;
-    ss >> order.id;
+    order.id = parseOrderID_(nextField_(rest));
+  }
+  else if (type_str == "C") {
+    type = ActionType::MassCancel;
+    if (auto symbol_str = nextField_(rest); !symbol_str.empty()) {
+      scope = CancelScope::Symbol;
+      order.symbol = Symbol(symbol_str);
+      if (auto side_str = nextField_(rest); !side_str.empty()) {
+        scope = CancelScope::Side;
+        order.side = parseSide_(side_str);
+      }
+    }
   }
   else if (type_str == "P") {
     type = ActionType::Print;
   }
+  else if (type_str == "H") {
+    type = ActionType::Hash;
+    order.symbol = Symbol(nextField_(rest));
+  }
+  else if (type_str == "D") {
+    type = ActionType::Delta;
+    order.symbol = Symbol(nextField_(rest));
+  }
+  else if (type_str == "M") {
+    type = ActionType::Memory;
+    order.symbol = Symbol(nextField_(rest));
+  }
+  else if (type_str == "T") {
+    type = ActionType::Stats;
+    auto symbol_str = nextField_(rest);
+    if (symbol_str.empty()) {
+      throw std::invalid_argument("Missing symbol");
+    }
+    order.symbol = Symbol(symbol_str);
+  }
   else {
     throw std::invalid_argument("Unknown action type");
   }
 
-  std::string left;
-  if (ss >> left) {
+  if (!nextField_(rest).empty()) {
     throw std::invalid_argument("Invalid order");
   }
 }
 
+// Splits the next whitespace-separated field off the front of s
+auto Action::nextField_(std::string_view & s) -> std::string_view
+{
+  constexpr std::string_view blanks = " \t\r\n";
+  auto begin = s.find_first_not_of(blanks);
+  if (begin == std::string_view::npos) {
+    s = {};
+    return {};
+  }
+  auto end = std::min(s.find_first_of(blanks, begin), s.size());
+  auto field = s.substr(begin, end - begin);
+  s.remove_prefix(end);
+  return field;
+}
+
+auto Action::parseSide_(std::string_view s) -> Side
+{
+  if (s == "B") {
+    return Side::Buy;
+  }
+  if (s == "S") {
+    return Side::Sell;
+  }
+  throw std::invalid_argument("Invalid side");
+}
+
+auto Action::parseTimeInForce_(std::string_view s) -> TimeInForce
+{
+  if (s == "GTC") {
+    return TimeInForce::GTC;
+  }
+  if (s == "IOC") {
+    return TimeInForce::IOC;
+  }
+  if (s == "FOK") {
+    return TimeInForce::FOK;
+  }
+  throw std::invalid_argument("Invalid time in force");
+}
+
+auto Action::parseOrderID_(std::string_view s) -> OrderID
+{
+  uint64_t val;
+  if (decodeUnsigned(s, val) != DecodeStatus::Ok || val > std::numeric_limits<OrderID>::max()) {
+    throw std::invalid_argument("Invalid order id");
+  }
+  return static_cast<OrderID>(val);
+}
+
+auto Action::parseQuantity_(std::string_view s) -> Quantity
+{
+  uint64_t val;
+  if (decodeUnsigned(s, val) != DecodeStatus::Ok || val > std::numeric_limits<Quantity>::max()) {
+    throw std::invalid_argument("Invalid quantity");
+  }
+  return static_cast<Quantity>(val);
+}
+
 
 }  // end namespace hft
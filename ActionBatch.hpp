@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <ostream>
+#include <span>
+#include "Action.hpp"
+#include "MultiSymbolBook.hpp"
+
+/*
+** Runs decoded actions against a MultiSymbolBook in batches.
+**
+** One action at a time, an add waits in a row for the opposite best level
+** and then for the queue behind it. A batch first walks its adds and issues
+** those loads as hints (MultiSymbolBook::prefetchAdd), so that the misses of
+** different actions overlap, then executes the actions in order. The hints
+** run in two passes over the batch: the first prefetches the level nodes,
+** whose addresses need no load, the second follows them to their queues once
+** they are cached. Cancels and the order map get no hints, as a hash probe
+** cannot start without loading its bucket. Execution is unchanged, so the
+** results are those of running the actions one by one.
+**
+** This pays off when the best levels are out of cache, as with adds spread
+** over many symbols (./bench book/batch-wide: about 20% with batches of 32).
+** On a few busy symbols they stay cached and batches change nothing
+** measurable (./bench book/batch).
+*/
+namespace hft {
+
+constexpr int PREFETCH_STAGES = 2;
+
+// Runs one action; its results are in book.getResults() until the next one
+auto execute(MultiSymbolBook & book, Action const & action) -> void
+{
+  switch (action.type) {
+    case ActionType::Place : {
+      book.add(action.order);
+      break;
+    }
+    case ActionType::Cancel : {
+      book.cancel(action.order.id);
+      break;
+    }
+    case ActionType::MassCancel : {
+      switch (action.scope) {
+        case CancelScope::Book : book.cancelAll(); break;
+        case CancelScope::Symbol : book.cancelSymbol(action.order.symbol); break;
+        case CancelScope::Side : book.cancelSide(action.order.symbol, action.order.side); break;
+      }
+      break;
+    }
+    case ActionType::Print : {
+      book.print();
+      break;
+    }
+    case ActionType::Hash : {
+      book.printHash(action.order.symbol);
+      break;
+    }
+    case ActionType::Stats : {
+      book.printStats(action.order.symbol);
+      break;
+    }
+    case ActionType::Memory : {
+      book.printMemory(action.order.symbol);
+      break;
+    }
+    case ActionType::Delta : {
+      book.printDelta(action.order.symbol);
+      break;
+    }
+  }
+}
+
+// Runs one action and writes its results to out, one per line. A P is
+// streamed from the book (MultiSymbolBook::printEntries) instead of being
+// collected in its results, so it holds one entry whatever the size of the book
+auto execute(MultiSymbolBook & book, Action const & action, std::ostream & out) -> void
+{
+  if (action.type == ActionType::Print) {
+    for (auto const & r : book.printEntries()) {
+      out << r << '\n';
+    }
+    return;
+  }
+  execute(book, action);
+  for (auto const & r : book.getResults()) {
+    out << r << '\n';
+  }
+}
+
+// Cache hints for one action: only adds get them (see MultiSymbolBook::prefetchAdd)
+auto prefetch(MultiSymbolBook const & book, Action const & action, int stage, PrefetchHint & hint) -> void
+{
+  if (action.type == ActionType::Place) {
+    book.prefetchAdd(action.order, stage, hint);
+  }
+}
+
+/*
+** Runs actions in batches of batch_size and calls sink(i, results) after
+** action i with its results, which stay valid until the next action runs.
+*/
+template <typename Sink>
+auto runBatch(MultiSymbolBook & book, std::span<Action const> actions, size_t batch_size, Sink && sink) -> void
+{
+  batch_size = std::max<size_t>(batch_size, 1);
+  std::vector<PrefetchHint> hints(batch_size > 1 ? batch_size : 0);
+  for (size_t begin = 0; begin < actions.size(); begin += batch_size) {
+    auto batch = actions.subspan(begin, std::min(batch_size, actions.size() - begin));
+    if (batch.size() > 1) {
+      for (int stage = 0; stage < PREFETCH_STAGES; ++stage) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+          prefetch(book, batch[i], stage, hints[i]);
+        }
+      }
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      execute(book, batch[i]);
+      sink(begin + i, book.getResults());
+    }
+  }
+}
+
+}  // end namespace hft
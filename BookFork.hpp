@@ -0,0 +1,278 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "MultiSymbolBook.hpp"
+
+namespace hft {
+
+/*
+** What-if view of a MultiSymbolBook: orders can be placed and cancelled on it
+** and it reports the Results the live book would produce, without changing
+** the live book.
+**
+** The fork shares the live levels and only records its differences:
+**   - the open quantity of every live order it fills or cancels
+**   - the orders placed on it that rest, in levels of its own
+** Creating one is O(number of symbols named), whatever the size of the book.
+** Matching walks the live and the fork's levels together in price order; at
+** one price the live orders come first, as they were placed earlier.
+**
+** A fork is tied to the state of the symbols it was made from. Once an order
+** of one of them is placed, filled or cancelled on the live book (of any
+** symbol for a fork of the whole book), every call on the fork answers "Fork
+** is stale"; changes to other symbols leave it usable. Stop orders are not
+** simulated: placing one answers "Stop orders are not simulated", and live
+** stops never trigger in the fork.
+*/
+class BookFork {
+  struct LocalBook {
+    std::map<Price, Level, std::greater<Price>> buy;
+    std::map<Price, Level> sell;
+  };
+
+  MultiSymbolBook const & _book;
+  uint64_t _version;              // of the book, for a fork of the whole book
+  std::vector<Symbol> _symbols;  // empty for all
+  std::vector<uint64_t> _versions;  // of each of _symbols
+  std::unordered_map<OrderID, Quantity> _open;  // live orders the fork filled or cancelled
+  std::unordered_map<OrderID, Order> _local_orders;
+  std::unordered_map<Symbol, LocalBook> _local;
+  std::vector<Result> _results;
+
+ public:
+  // Forks the books of symbols, or the whole book if none are named
+  explicit BookFork(MultiSymbolBook const & book, std::vector<Symbol> symbols = {})
+      : _book(book), _version(book.version()), _symbols(std::move(symbols))
+  {
+    for (auto const & symbol : _symbols) {
+      _versions.push_back(book.version(symbol));
+    }
+  }
+
+  void add(Order const & order);
+  void cancel(OrderID id);
+  std::vector<Result> const & getResults() const { return _results; }
+  auto stale() const -> bool;
+
+ private:
+  auto covers_(Symbol const & symbol) const -> bool;
+  auto liveOpen_(OrderID id, Quantity quantity) const -> Quantity;
+  template <typename LiveLevels, typename LocalLevels>
+  auto match_(LiveLevels const & live, LocalLevels & local, Order & incoming) -> void;
+  template <typename LiveLevels, typename LocalLevels>
+  auto canFill_(LiveLevels const & live, LocalLevels const & local, Order const & incoming) const -> bool;
+  template <typename LocalLevels>
+  auto removeLocal_(LocalLevels & levels, Order const & order) -> void;
+};
+
+auto BookFork::stale() const -> bool
+{
+  if (_symbols.empty()) {
+    return _book.version() != _version;
+  }
+  for (size_t i = 0; i < _symbols.size(); ++i) {
+    if (_book.version(_symbols[i]) != _versions[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto BookFork::covers_(Symbol const & symbol) const -> bool
+{
+  return _symbols.empty() || std::find(_symbols.begin(), _symbols.end(), symbol) != _symbols.end();
+}
+
+// Open quantity in the fork of a live resting order with the given live quantity
+auto BookFork::liveOpen_(OrderID id, Quantity quantity) const -> Quantity
+{
+  auto it = _open.find(id);
+  return it == _open.end() ? quantity : it->second;
+}
+
+void BookFork::add(Order const & order)
+{
+  _results.clear();
+  if (stale()) {
+    _results.emplace_back(Result::Error(order.id, "Fork is stale"));
+    return;
+  }
+  if (!covers_(order.symbol)) {
+    _results.emplace_back(Result::Error(order.id, "Symbol is not in the fork"));
+    return;
+  }
+  if (order.type != OrderType::Limit) {
+    _results.emplace_back(Result::Error(order.id, "Stop orders are not simulated"));
+    return;
+  }
+  auto live = _book.order(order.id);
+  if (_local_orders.count(order.id) || (live && liveOpen_(order.id, 1))) {
+    _results.emplace_back(Result::Error(order.id, "Duplicate order id"));
+    return;
+  }
+
+  static BuyLevels const no_buys;
+  static SellLevels const no_sells;
+  auto matcher = _book.matcher(order.symbol);
+  auto & local = _local[order.symbol];
+  auto incoming = order;
+  if (incoming.side == Side::Buy) {
+    auto const & live = matcher ? matcher->sellLevels() : no_sells;
+    if (incoming.tif != TimeInForce::FOK || canFill_(live, local.sell, incoming)) {
+      match_(live, local.sell, incoming);
+    }
+  }
+  else {
+    auto const & live = matcher ? matcher->buyLevels() : no_buys;
+    if (incoming.tif != TimeInForce::FOK || canFill_(live, local.buy, incoming)) {
+      match_(live, local.buy, incoming);
+    }
+  }
+  if (incoming.quantity && incoming.tif != TimeInForce::GTC) {
+    incoming.quantity = 0;
+    _results.emplace_back(Result::CancelConfirm(incoming.id, incoming.symbol));
+  }
+  if (!incoming.quantity) {
+    return;
+  }
+  if (incoming.side == Side::Buy) {
+    local.buy[incoming.price].push({incoming.id, incoming.quantity});
+  }
+  else {
+    local.sell[incoming.price].push({incoming.id, incoming.quantity});
+  }
+  _local_orders.emplace(incoming.id, incoming);
+}
+
+/*
+** Whether the levels the incoming order crosses hold its whole quantity. The
+** fork's own levels are summed from their totals; live orders are counted one
+** by one, as the fork may have filled or cancelled some of them.
+*/
+template <typename LiveLevels, typename LocalLevels>
+auto BookFork::canFill_(LiveLevels const & live, LocalLevels const & local, Order const & incoming) const -> bool
+{
+  auto const better = local.key_comp();
+  uint64_t available = 0;
+  for (auto it = local.begin(); it != local.end() && !better(incoming.price, it->first); ++it) {
+    available += it->second.quantity;
+  }
+  for (auto it = live.begin(); it != live.end() && !better(incoming.price, it->first); ++it) {
+    for (auto const & resting : it->second.orders) {
+      available += liveOpen_(resting.id, resting.quantity);
+    }
+    if (available >= incoming.quantity) {
+      break;
+    }
+  }
+  return available >= incoming.quantity;
+}
+
+/*
+** Same fills as OrderMatcher::tryBuy_ / trySell_: resting orders in price-time
+** priority at the incoming order's price, then one confirmation for the
+** incoming order.
+*/
+template <typename LiveLevels, typename LocalLevels>
+auto BookFork::match_(LiveLevels const & live, LocalLevels & local, Order & incoming) -> void
+{
+  auto const better = local.key_comp();
+  auto const old_quantity = incoming.quantity;
+  auto live_it = live.begin();
+  auto local_it = local.begin();
+  while (incoming.quantity && (live_it != live.end() || local_it != local.end())) {
+    auto price = local_it == local.end() ||
+        (live_it != live.end() && !better(local_it->first, live_it->first)) ? live_it->first : local_it->first;
+    if (incoming.side == Side::Buy ? incoming.price < price : incoming.price > price) {
+      break;
+    }
+    if (live_it != live.end() && live_it->first == price) {
+      for (auto const & resting : live_it->second.orders) {
+        auto open = liveOpen_(resting.id, resting.quantity);
+        if (!open) {
+          continue;
+        }
+        Quantity fill_quantity = std::min(open, incoming.quantity);
+        _results.emplace_back(Result::FillConfirm(resting.id, incoming.symbol, fill_quantity, incoming.price));
+        _open[resting.id] = open - fill_quantity;
+        incoming.quantity -= fill_quantity;
+        if (!incoming.quantity) {
+          break;
+        }
+      }
+      ++live_it;
+    }
+    if (incoming.quantity && local_it != local.end() && local_it->first == price) {
+      auto & level = local_it->second.orders;
+      auto resting = level.begin();
+      for (; resting != level.end() && incoming.quantity; ++resting) {
+        Quantity fill_quantity = std::min(resting->quantity, incoming.quantity);
+        _results.emplace_back(Result::FillConfirm(resting->id, incoming.symbol, fill_quantity, incoming.price));
+        local_it->second.quantity -= fill_quantity;
+        resting->quantity -= fill_quantity;
+        incoming.quantity -= fill_quantity;
+        if (resting->quantity) {
+          break;
+        }
+        _local_orders.erase(resting->id);
+      }
+      level.erase(level.begin(), resting);
+      local_it = level.empty() ? local.erase(local_it) : std::next(local_it);
+    }
+  }
+  if (incoming.quantity < old_quantity) {
+    _results.emplace_back(Result::FillConfirm(incoming.id, incoming.symbol, old_quantity - incoming.quantity,
+                                              incoming.price));
+  }
+}
+
+void BookFork::cancel(OrderID id)
+{
+  _results.clear();
+  if (stale()) {
+    _results.emplace_back(Result::Error(id, "Fork is stale"));
+    return;
+  }
+  if (auto it = _local_orders.find(id); it != _local_orders.end()) {
+    auto & local = _local[it->second.symbol];
+    if (it->second.side == Side::Buy) {
+      removeLocal_(local.buy, it->second);
+    }
+    else {
+      removeLocal_(local.sell, it->second);
+    }
+    _results.emplace_back(Result::CancelConfirm(id, it->second.symbol));
+    _local_orders.erase(it);
+    return;
+  }
+  auto live = _book.order(id);
+  if (!live || !liveOpen_(id, 1)) {
+    _results.emplace_back(Result::Error(id, "Order does not exist"));
+    return;
+  }
+  if (!covers_(live->symbol)) {
+    _results.emplace_back(Result::Error(id, "Symbol is not in the fork"));
+    return;
+  }
+  _open[id] = 0;
+  _results.emplace_back(Result::CancelConfirm(id, live->symbol));
+}
+
+template <typename LocalLevels>
+auto BookFork::removeLocal_(LocalLevels & levels, Order const & order) -> void
+{
+  auto level = levels.find(order.price);
+  auto & resting = level->second.orders;
+  auto it = std::find_if(resting.begin(), resting.end(), [&](RestingOrder const & r) {
+    return r.id == order.id;
+  });
+  level->second.quantity -= it->quantity;
+  resting.erase(it);
+  if (resting.empty()) {
+    levels.erase(level);
+  }
+}
+
+}  // end namespace hft
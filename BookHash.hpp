@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include "basic_types.hpp"
+
+/*
+** Incremental hash of the resting orders of a book (Zobrist-style).
+**
+** Every resting order gets a pseudo-random odd key derived from its id,
+** symbol, side, price and time priority (the per-symbol sequence number that
+** orders its queue), and contributes key * remaining quantity to a wrapping
+** 64-bit sum. Placing, filling and cancelling an order are then a single
+** multiply-add: a fill of q subtracts key * q, and an order that leaves the
+** book has contributed nothing once its quantity reaches zero. Sums of
+** disjoint books add up, so a book's hash is the sum of its symbols' hashes.
+*/
+namespace hft {
+
+// splitmix64 finalizer
+constexpr auto mix64(uint64_t x) -> uint64_t
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+// FNV-1a, so that hashes compare across builds and standard libraries
+auto symbolKey(Symbol const & symbol) -> uint64_t
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (auto c : symbol.view()) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+auto orderKey(Order const & order, uint64_t symbol_key) -> uint64_t
+{
+  auto h = mix64(symbol_key ^ order.id);
+  h = mix64(h ^ static_cast<uint64_t>(order.side));
+  h = mix64(h ^ static_cast<uint64_t>(order.price.raw()));
+  h = mix64(h ^ order.seq);
+  return h | 1;
+}
+
+}  // end namespace hft
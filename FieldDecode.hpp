@@ -0,0 +1,222 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+/*
+** Decoders for the fixed-shape ASCII fields of an action line.
+**
+** Every field fits in 16 bytes (a 7.5 price is at most 13 characters, an
+** order id at most 10 digits), so the vector path right-aligns the field into
+** a single SSE register padded with '0', validates all lanes at once and folds
+** the digits with multiply-adds. Wider registers would only hold padding, so
+** there is no separate AVX2 path; building with -mavx2 still selects the SSE4.1
+** decoder. Without SSE4.1 the scalar decoder is used.
+**
+** Status classification (mirrors what Price::fromString always did, except
+** that a '+' sign, which its std::stoll let through, is refused as well):
+**   BadFormat - the field has the wrong shape (empty, too long, misplaced '.',
+**               a price with a '+' or '-' sign)
+**   BadDigit  - the shape is right but a character is not a digit
+*/
+namespace hft {
+
+enum class DecodeStatus { Ok, BadFormat, BadDigit };
+
+std::ostream& operator<<(std::ostream& os, DecodeStatus status) {
+  switch (status) {
+    case DecodeStatus::Ok: os << "Ok"; break;
+    case DecodeStatus::BadFormat: os << "BadFormat"; break;
+    case DecodeStatus::BadDigit: os << "BadDigit"; break;
+  }
+  return os;
+}
+
+// Digits of the 7.5 price format: up to 7 before the dot, exactly 5 after
+constexpr size_t PRICE_DECIMALS = 5;
+constexpr size_t PRICE_MAX_LENGTH = 7 + 1 + PRICE_DECIMALS;
+// Longest decimal that always fits in 64 bits
+constexpr size_t UNSIGNED_MAX_LENGTH = 19;
+
+/*
+** Price::_val stores integral * 10^6 + decimal with a 5-digit decimal, which is
+** exactly the number spelled by the field with its '.' read as a '0'. Both
+** decoders rely on that.
+*/
+auto decodePriceScalar(std::string_view s, int64_t & val) -> DecodeStatus
+{
+  if (s.empty() || s.size() > PRICE_MAX_LENGTH) {
+    return DecodeStatus::BadFormat;
+  }
+  auto dot = s.find('.');
+  if (dot == std::string_view::npos || dot != s.size() - PRICE_DECIMALS - 1) {
+    return DecodeStatus::BadFormat;
+  }
+  // Prices are unsigned: a sign in either part is a format error, not a bad digit
+  if (s.find_first_of("+-") != std::string_view::npos) {
+    return DecodeStatus::BadFormat;
+  }
+  if (dot == 0) {
+    return DecodeStatus::BadDigit;
+  }
+  int64_t ans = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    auto digit = static_cast<unsigned char>(s[i] - '0');
+    if (i == dot) {
+      digit = 0;
+    }
+    else if (digit > 9) {
+      return DecodeStatus::BadDigit;
+    }
+    ans = ans * 10 + digit;
+  }
+  val = ans;
+  return DecodeStatus::Ok;
+}
+
+auto decodeUnsignedScalar(std::string_view s, uint64_t & val) -> DecodeStatus
+{
+  if (s.empty() || s.size() > UNSIGNED_MAX_LENGTH) {
+    return DecodeStatus::BadFormat;
+  }
+  uint64_t ans = 0;
+  for (auto c : s) {
+    auto digit = static_cast<unsigned char>(c - '0');
+    if (digit > 9) {
+      return DecodeStatus::BadDigit;
+    }
+    ans = ans * 10 + digit;
+  }
+  val = ans;
+  return DecodeStatus::Ok;
+}
+
+#if defined(__SSE4_1__)
+
+namespace detail {
+
+/*
+** Byte shuffles for loadRightAligned_, indexed by field length. The field is
+** read as two overlapping halves (8 bytes each for 8..16 characters, 4 bytes
+** for 4..7) into lanes 0.. and 8..; the shuffle moves every character to
+** lane 16 - size + index and marks the lanes in front of it with 0x80.
+*/
+constexpr auto RIGHT_ALIGN_SHUFFLE = [] {
+  std::array<std::array<int8_t, 16>, 17> table{};
+  for (int size = 4; size <= 16; ++size) {
+    int half = size >= 8 ? 8 : 4;
+    for (int lane = 0; lane < 16; ++lane) {
+      int c = lane - (16 - size);
+      table[size][lane] = static_cast<int8_t>(c < 0 ? -128 : c < half ? c : 8 + c - (size - half));
+    }
+  }
+  return table;
+}();
+
+// 4 <= s.size() <= 16. Lane 0 holds the most significant character, the lanes
+// in front of the field hold '0'. Never reads outside of s.
+auto loadRightAligned_(std::string_view s) -> __m128i
+{
+  int64_t lo = 0, hi = 0;
+  if (s.size() >= 8) {
+    std::memcpy(&lo, s.data(), 8);
+    std::memcpy(&hi, s.data() + s.size() - 8, 8);
+  }
+  else {
+    std::memcpy(&lo, s.data(), 4);
+    std::memcpy(&hi, s.data() + s.size() - 4, 4);
+  }
+  auto const shuffle = _mm_loadu_si128(reinterpret_cast<__m128i const *>(RIGHT_ALIGN_SHUFFLE[s.size()].data()));
+  auto const chars = _mm_shuffle_epi8(_mm_set_epi64x(hi, lo), shuffle);
+  return _mm_blendv_epi8(chars, _mm_set1_epi8('0'), shuffle);
+}
+
+// Bit i is set if lane i holds a value in 0..9
+auto digitMask_(__m128i digits) -> uint32_t
+{
+  auto const nine = _mm_set1_epi8(9);
+  auto const ok = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+  return static_cast<uint32_t>(_mm_movemask_epi8(ok));
+}
+
+// Folds 16 digit lanes (most significant first) into their value
+auto fold16_(__m128i digits) -> uint64_t
+{
+  auto const pairs = _mm_maddubs_epi16(digits, _mm_set_epi8(1, 10, 1, 10, 1, 10, 1, 10,
+                                                             1, 10, 1, 10, 1, 10, 1, 10));
+  auto const quads = _mm_madd_epi16(pairs, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+  auto const packed = _mm_packus_epi32(quads, quads);
+  auto const octs = _mm_madd_epi16(packed, _mm_set_epi16(1, 10000, 1, 10000, 1, 10000, 1, 10000));
+  uint64_t const hi = static_cast<uint32_t>(_mm_cvtsi128_si32(octs));
+  uint64_t const lo = static_cast<uint32_t>(_mm_extract_epi32(octs, 1));
+  return hi * 100'000'000 + lo;
+}
+
+}  // end namespace detail
+
+auto decodePriceSimd(std::string_view s, int64_t & val) -> DecodeStatus
+{
+  // Anything shorter than "0.00000" or longer than 7.5 is malformed
+  if (s.size() < PRICE_DECIMALS + 2 || s.size() > PRICE_MAX_LENGTH) {
+    return decodePriceScalar(s, val);
+  }
+  constexpr int DOT_LANE = 16 - PRICE_DECIMALS - 1;
+  auto const chars = detail::loadRightAligned_(s);
+  auto const dots = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('.'))));
+  if (!dots || __builtin_ctz(dots) != DOT_LANE) {
+    return DecodeStatus::BadFormat;
+  }
+  auto const signs = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('+')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('-')));
+  if (_mm_movemask_epi8(signs)) {
+    return DecodeStatus::BadFormat;
+  }
+  auto digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  if (detail::digitMask_(digits) != (0xFFFFu & ~(1u << DOT_LANE))) {
+    return DecodeStatus::BadDigit;
+  }
+  digits = _mm_and_si128(digits, _mm_set_epi8(-1, -1, -1, -1, -1, 0, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1));
+  val = static_cast<int64_t>(detail::fold16_(digits));
+  return DecodeStatus::Ok;
+}
+
+// Fields shorter than 4 characters are quicker to do in the scalar loop
+auto decodeUnsignedSimd(std::string_view s, uint64_t & val) -> DecodeStatus
+{
+  if (s.size() < 4 || s.size() > 16) {
+    return decodeUnsignedScalar(s, val);
+  }
+  auto const digits = _mm_sub_epi8(detail::loadRightAligned_(s), _mm_set1_epi8('0'));
+  if (detail::digitMask_(digits) != 0xFFFFu) {
+    return DecodeStatus::BadDigit;
+  }
+  val = detail::fold16_(digits);
+  return DecodeStatus::Ok;
+}
+
+#endif
+
+auto decodePrice(std::string_view s, int64_t & val) -> DecodeStatus
+{
+#if defined(__SSE4_1__)
+  return decodePriceSimd(s, val);
+#else
+  return decodePriceScalar(s, val);
+#endif
+}
+
+auto decodeUnsigned(std::string_view s, uint64_t & val) -> DecodeStatus
+{
+#if defined(__SSE4_1__)
+  return decodeUnsignedSimd(s, val);
+#else
+  return decodeUnsignedScalar(s, val);
+#endif
+}
+
+}  // end namespace hft
@@ -0,0 +1,102 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+/*
+** A lazy sequence produced by a coroutine, for the compilers without
+** std::generator. The body runs up to its next co_yield each time the
+** iterator advances, so only the current value is held, not the sequence.
+** Values are yielded by reference: each stays valid until the iterator
+** advances. A Generator is single-pass and move-only.
+**
+**   auto counter(int n) -> Generator<int> {
+**     for (int i = 0; i < n; ++i) co_yield i;
+**   }
+*/
+namespace hft {
+
+template <typename T>
+class Generator {
+ public:
+  struct promise_type
+  {
+    T const * value{nullptr};
+    std::exception_ptr error;
+
+    auto get_return_object() -> Generator {
+      return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+    auto final_suspend() noexcept -> std::suspend_always { return {}; }
+    auto yield_value(T const & v) noexcept -> std::suspend_always {
+      value = &v;
+      return {};
+    }
+    auto return_void() noexcept -> void {}
+    auto unhandled_exception() -> void { error = std::current_exception(); }
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> _handle;
+
+   public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+    auto operator*() const -> T const & { return *_handle.promise().value; }
+    auto operator->() const -> T const * { return _handle.promise().value; }
+    auto operator++() -> iterator & {
+      resume_(_handle);
+      return *this;
+    }
+    auto operator++(int) -> void { ++*this; }
+    auto operator==(std::default_sentinel_t) const -> bool { return !_handle || _handle.done(); }
+  };
+
+  Generator(Generator && other) noexcept : _handle(std::exchange(other._handle, {})) {}
+  auto operator=(Generator && other) noexcept -> Generator & {
+    if (this != &other) {
+      destroy_();
+      _handle = std::exchange(other._handle, {});
+    }
+    return *this;
+  }
+  Generator(Generator const &) = delete;
+  auto operator=(Generator const &) -> Generator & = delete;
+  ~Generator() { destroy_(); }
+
+  // Runs the body to its first co_yield
+  auto begin() -> iterator {
+    resume_(_handle);
+    return iterator(_handle);
+  }
+  auto end() const -> std::default_sentinel_t { return {}; }
+
+ private:
+  std::coroutine_handle<promise_type> _handle;
+
+  explicit Generator(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+  // Rethrows what the body threw, at the point the caller asked for a value
+  static auto resume_(std::coroutine_handle<promise_type> handle) -> void {
+    if (handle && !handle.done()) {
+      handle.resume();
+      if (auto error = std::exchange(handle.promise().error, {})) {
+        std::rethrow_exception(error);
+      }
+    }
+  }
+
+  auto destroy_() -> void {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+};
+
+}  // end namespace hft
@@ -0,0 +1,188 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <sys/mman.h>
+
+/*
+** Memory for a MultiSymbolBook on 2 MB pages, mapped and faulted in up front
+** so that matching never takes a page fault or walks a 4 KB page table.
+**
+** The mapping is tried in order of preference:
+**   HugeTLB          MAP_HUGETLB, needs pages reserved in vm.nr_hugepages
+**   TransparentHuge  a 2 MB aligned mapping with madvise(MADV_HUGEPAGE), needs
+**                    THP set to "madvise" or "always"
+**   Normal           plain pages, still pre-faulted
+** HugePageArena hands the mapping out monotonically and goes to the heap once
+** it is used up. BookArena puts a pool on top of it, which recycles the blocks
+** that orders, levels and queues free, so a long session stays inside the
+** arena. Blocks above POOL_BLOCK_LIMIT (large level queues, hash buckets) are not
+** recycled by the pool and are taken from the arena for good.
+*/
+namespace hft {
+
+enum class PageBacking { HugeTLB, TransparentHuge, Normal, None };
+
+std::ostream& operator<<(std::ostream& os, PageBacking backing) {
+  switch (backing) {
+    case PageBacking::HugeTLB: os << "HugeTLB"; break;
+    case PageBacking::TransparentHuge: os << "TransparentHuge"; break;
+    case PageBacking::Normal: os << "Normal"; break;
+    case PageBacking::None: os << "None"; break;
+  }
+  return os;
+}
+
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+class HugePageArena : public std::pmr::memory_resource {
+  std::byte * _base{nullptr};
+  size_t _mapped{0};    // length of the mapping
+  size_t _capacity{0};  // end of the usable bytes, from _base
+  size_t _used{0};
+  size_t _overflow{0};  // bytes that had to come from the heap
+  PageBacking _backing{PageBacking::None};
+  std::string _error;   // why a preferred backing was not used
+
+ public:
+  // huge_pages false maps normal pages straight away
+  explicit HugePageArena(size_t bytes, bool huge_pages = true);
+  ~HugePageArena();
+  HugePageArena(HugePageArena const &) = delete;
+  auto operator=(HugePageArena const &) -> HugePageArena & = delete;
+
+  auto backing() const -> PageBacking { return _backing; }
+  auto error() const -> std::string const & { return _error; }
+  auto capacity() const -> size_t { return _capacity; }
+  auto used() const -> size_t { return _used; }
+  auto overflow() const -> size_t { return _overflow; }
+
+ private:
+  auto map_(size_t bytes, bool huge_pages) -> void;
+  auto prefault_() -> void;
+  auto note_(std::string_view what) -> void;
+  auto owns_(void const * p) const -> bool;
+
+  auto do_allocate(size_t bytes, size_t alignment) -> void * override;
+  auto do_deallocate(void * p, size_t bytes, size_t alignment) -> void override;
+  auto do_is_equal(std::pmr::memory_resource const & other) const noexcept -> bool override;
+};
+
+HugePageArena::HugePageArena(size_t bytes, bool huge_pages)
+{
+  map_((bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE, huge_pages);
+  prefault_();
+}
+
+HugePageArena::~HugePageArena()
+{
+  if (_base) {
+    munmap(_base, _mapped);
+  }
+}
+
+auto HugePageArena::note_(std::string_view what) -> void
+{
+  if (_error.empty()) {
+    _error = std::string(what) + ": " + std::strerror(errno);
+  }
+}
+
+auto HugePageArena::map_(size_t bytes, bool huge_pages) -> void
+{
+  if (!bytes) {
+    return;
+  }
+  constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (huge_pages) {
+    auto p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      _base = static_cast<std::byte *>(p);
+      _mapped = _capacity = bytes;
+      _backing = PageBacking::HugeTLB;
+      return;
+    }
+    note_("MAP_HUGETLB");
+  }
+
+  // One extra huge page of slack to align the start for THP
+  auto extra = huge_pages ? HUGE_PAGE_SIZE : 0;
+  auto p = mmap(nullptr, bytes + extra, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (p == MAP_FAILED) {
+    note_("mmap");
+    return;
+  }
+  _base = static_cast<std::byte *>(p);
+  _mapped = _capacity = bytes + extra;
+  // Memory is handed out from the aligned start, the slack in front stays unused
+  auto misalignment = reinterpret_cast<uintptr_t>(_base) % HUGE_PAGE_SIZE;
+  _used = extra && misalignment ? HUGE_PAGE_SIZE - misalignment : 0;
+  _backing = PageBacking::Normal;
+  if (huge_pages) {
+    if (madvise(_base + _used, _capacity - _used, MADV_HUGEPAGE) == 0) {
+      _backing = PageBacking::TransparentHuge;
+    }
+    else {
+      note_("MADV_HUGEPAGE");
+    }
+  }
+}
+
+// One write per 4 KB page maps the whole arena before the first order arrives
+auto HugePageArena::prefault_() -> void
+{
+  for (size_t i = _used; i < _capacity; i += 4096) {
+    static_cast<volatile std::byte *>(_base)[i] = std::byte{0};
+  }
+}
+
+auto HugePageArena::owns_(void const * p) const -> bool
+{
+  auto b = static_cast<std::byte const *>(p);
+  return _base && b >= _base && b < _base + _capacity;
+}
+
+auto HugePageArena::do_allocate(size_t bytes, size_t alignment) -> void *
+{
+  auto begin = (_used + alignment - 1) / alignment * alignment;
+  if (_base && begin + bytes <= _capacity) {
+    _used = begin + bytes;
+    return _base + begin;
+  }
+  _overflow += bytes;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+auto HugePageArena::do_deallocate(void * p, size_t bytes, size_t alignment) -> void
+{
+  if (!owns_(p)) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+}
+
+auto HugePageArena::do_is_equal(std::pmr::memory_resource const & other) const noexcept -> bool
+{
+  return this == &other;
+}
+
+// Largest block the pool recycles
+constexpr size_t POOL_BLOCK_LIMIT = 64 << 10;
+
+// What a MultiSymbolBook is constructed with to live on huge pages
+struct BookArena
+{
+  HugePageArena arena;
+  std::pmr::unsynchronized_pool_resource pool;
+
+  explicit BookArena(size_t bytes, bool huge_pages = true)
+      : arena(bytes, huge_pages),
+        pool(std::pmr::pool_options{0, POOL_BLOCK_LIMIT}, &arena)
+  {}
+
+  auto resource() -> std::pmr::memory_resource * { return &pool; }
+};
+
+}  // end namespace hft
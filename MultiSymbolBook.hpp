@@ -1,37 +1,93 @@
 #pragma once
+#include <algorithm>
+#include <map>
+#include <string_view>
 #include <unordered_map>
 #include "basic_types.hpp"
+#include "Generator.hpp"
 #include "OrderMatcher.hpp"
 
 namespace hft {
 
+// What the hint stages of one action found so far (see ActionBatch.hpp)
+struct PrefetchHint
+{
+  Level const * level{nullptr};  // opposite best level of an add
+};
+
 class MultiSymbolBook {
-  std::unordered_map<OrderID, Order> _orders;
+  OrderMap _orders;
   std::unordered_map<Symbol, OrderMatcher> _matchers;
+  // The matchers in symbol order, for the whole-book walks; keyed by views of
+  // the _matchers keys, whose nodes do not move
+  std::map<std::string_view, OrderMatcher *> _by_symbol;
   std::vector<Result> _results;
+  uint64_t _hash{0};  // sum of the matchers' hashes
+  uint64_t _trades_per_bar{0};
+  size_t _nbars{0};
+  TradeTape * _tape{nullptr};
+  uint64_t _actions{0};        // clock of the idle policy
+  uint64_t _reclaim_after{0};  // idle actions before a symbol is reclaimed, 0 for never
+  uint64_t _last_sweep{0};
+  uint64_t _version{0};        // bumped by every change to the orders
 
  public:
-  MultiSymbolBook() = default;
+  // Orders, levels and queues are allocated from resource, which must outlive
+  // the book (see HugePageArena.hpp)
+  explicit MultiSymbolBook(std::pmr::memory_resource * resource = std::pmr::get_default_resource())
+      : _orders(resource)
+  {}
   ~MultiSymbolBook() = default;
+  // The matchers and the symbol index refer to the book's own order map
+  MultiSymbolBook(MultiSymbolBook const &) = delete;
+  auto operator=(MultiSymbolBook const &) -> MultiSymbolBook & = delete;
 
   void add(Order const &order) {
-    _results.clear();
+    beginAction_();
     if (_orders.count(order.id)) {
       _results.emplace_back(Result::Error(order.id, "Duplicate order id"));
       return;
     }
+    ++_version;
     _orders[order.id] = order;
     if (!_matchers.count(order.symbol)) {
-      _matchers.emplace(order.symbol, OrderMatcher(_orders, order.symbol));
+      auto & [symbol, matcher] = *_matchers.emplace(order.symbol, OrderMatcher(_orders, order.symbol)).first;
+      matcher.configureBars(_trades_per_bar, _nbars);
+      matcher.setTape(_tape);
+      _by_symbol.emplace(symbol.view(), &matcher);
     }
-    _matchers.find(order.symbol)->second.add(order.id, _results);
+    auto & matcher = _matchers.find(order.symbol)->second;
+    auto before = matcher.hash();
+    matcher.touch(_actions);
+    matcher.markChanged(_version);
+    matcher.add(order.id, _results);
+    _hash += matcher.hash() - before;
+    if (_tape) {
+      _tape->publish();
+    }
+  }
 
-    for (auto const & result : _results) {
-      if (result.type == ResultType::FillConfirm && _orders[result.order_id].quantity == 0) {
-        // std::cout << "erasing order " << result.order_id << std::endl;
-        _orders.erase(result.order_id);
+  /*
+  ** Cache hints ahead of add(order), in two stages (see ActionBatch.hpp).
+  ** Stage 0 takes the address of the opposite best level from its tree
+  ** header and prefetches it; stage 1, once every action of the batch had its
+  ** stage 0, reads that level, cached by then, and prefetches the front of
+  ** its queue. Neither stage reads memory it did not prefetch a stage before,
+  ** apart from the matcher table, which is small and stays cached. Order map
+  ** entries get no hint: a hash probe cannot start without loading its bucket.
+  ** The hints only read the book: they all run before the batch executes.
+  */
+  void prefetchAdd(Order const & order, int stage, PrefetchHint & hint) const {
+    if (stage == 0) {
+      auto it = _matchers.find(order.symbol);
+      hint.level = it == _matchers.end() ? nullptr : it->second.bestOpposite(order.side);
+      if (hint.level) {
+        __builtin_prefetch(hint.level);
       }
     }
+    else if (hint.level && !hint.level->orders.empty()) {
+      __builtin_prefetch(hint.level->orders.data());
+    }
   }
 
   std::vector<Result> const & getResults() {
@@ -39,24 +95,272 @@ class MultiSymbolBook {
   }
 
   void cancel(OrderID id) {
-    _results.clear();
+    beginAction_();
     if (!_orders.count(id)) {
       _results.emplace_back(Result::Error(id, "Order does not exist"));
     }
     else {
+      ++_version;
       auto &order = _orders[id];
-      _matchers.find(order.symbol)->second.cancel(id, _results);
-      _orders.erase(id);
+      auto & matcher = _matchers.find(order.symbol)->second;
+      auto before = matcher.hash();
+      matcher.touch(_actions);
+      matcher.markChanged(_version);
+      matcher.cancel(id, _results);
+      _hash += matcher.hash() - before;
+    }
+  }
+
+  // Mass cancel: one X per order, symbols in lexicographic order, then as
+  // OrderMatcher::cancelAll orders them
+  void cancelAll() {
+    beginAction_();
+    for (auto & [symbol, matcher] : _by_symbol) {
+      auto before = _results.size();
+      matcher->cancelAll(_results);
+      if (_results.size() != before) {
+        changed_(*matcher);
+      }
     }
+    _hash = 0;
+  }
+
+  void cancelSymbol(Symbol const & symbol) {
+    beginAction_();
+    if (auto it = _matchers.find(symbol); it != _matchers.end()) {
+      _hash -= it->second.hash();
+      it->second.touch(_actions);
+      it->second.cancelAll(_results);
+      if (!_results.empty()) {
+        changed_(it->second);
+      }
+    }
+  }
+
+  void cancelSide(Symbol const & symbol, Side side) {
+    beginAction_();
+    if (auto it = _matchers.find(symbol); it != _matchers.end()) {
+      auto before = it->second.hash();
+      it->second.touch(_actions);
+      it->second.cancelSide(side, _results);
+      _hash += it->second.hash() - before;
+      if (!_results.empty()) {
+        changed_(it->second);
+      }
+    }
+  }
+
+  // Hash of the resting orders (see BookHash.hpp), O(1)
+  auto hash() const -> uint64_t {
+    return _hash;
+  }
+
+  auto hash(Symbol const & symbol) const -> uint64_t {
+    auto it = _matchers.find(symbol);
+    return it == _matchers.end() ? 0 : it->second.hash();
+  }
+
+  // Reports the hash of the whole book, or of one symbol if given
+  void printHash(Symbol const & symbol) {
+    beginAction_();
+    auto whole = symbol.view().empty();
+    _results.emplace_back(Result::BookHash(symbol, whole ? hash() : hash(symbol)));
+  }
+
+  // Buckets the trades of every symbol into bars of trades_per_bar trades
+  // and keeps the last nbars of them (see TradeStats.hpp)
+  void setTradeBars(uint64_t trades_per_bar, size_t nbars) {
+    _trades_per_bar = trades_per_bar;
+    _nbars = nbars;
+    for (auto & [symbol, matcher] : _matchers) {
+      matcher.configureBars(trades_per_bar, nbars);
+    }
+  }
+
+  // Records every trade of every symbol on tape, which must outlive the
+  // book or be detached with nullptr (see TradeTape.hpp)
+  void setTradeTape(TradeTape * tape) {
+    _tape = tape;
+    for (auto & [symbol, matcher] : _matchers) {
+      matcher.setTape(tape);
+    }
+  }
+
+  auto tradeStats(Symbol const & symbol) const -> TradeStats const * {
+    auto it = _matchers.find(symbol);
+    return it == _matchers.end() ? nullptr : &it->second.tradeStats();
+  }
+
+  // Reports the trade statistics of a symbol, O(number of bars kept)
+  void printStats(Symbol const & symbol) {
+    static TradeBar const no_trades;
+    beginAction_();
+    if (auto it = _matchers.find(symbol); it != _matchers.end()) {
+      it->second.printStats(_results);
+    }
+    else {
+      _results.emplace_back(Result::TradeStats(symbol, no_trades));
+    }
+  }
+
+  /*
+  ** The resting orders as BookEntry results, symbols in lexicographic order,
+  ** then as OrderMatcher::entries orders them. They are produced one at a
+  ** time as the caller iterates, so a walk holds one entry whatever the size
+  ** of the book; the book must not change until the walk is over.
+  */
+  auto entries() const -> Generator<Result> {
+    for (auto const & [symbol, matcher] : _by_symbol) {
+      for (auto const & entry : matcher->entries()) {
+        co_yield entry;
+      }
+    }
+  }
+
+  // P without buffering: the entries come from the generator, not getResults()
+  auto printEntries() -> Generator<Result> {
+    beginAction_();
+    return entries();
   }
 
   void print() {
+    for (auto const & entry : printEntries()) {
+      _results.push_back(entry);
+    }
+  }
+
+  // Resting orders added, changed or removed since the previous delta dump
+  // of the symbol, of every symbol in symbol order if it is empty (see OrderMatcher::printDelta)
+  void printDelta(Symbol const & symbol) {
+    beginAction_();
+    if (!symbol.view().empty()) {
+      if (auto it = _matchers.find(symbol); it != _matchers.end()) {
+        it->second.printDelta(_results);
+      }
+      return;
+    }
+    for (auto & [name, matcher] : _by_symbol) {
+      matcher->printDelta(_results);
+    }
+  }
+
+  /*
+  ** Idle symbols are reclaimed once no order of theirs was placed or
+  ** cancelled for idle_actions actions of the book (0, the default, never
+  ** reclaims). Every idle_actions actions a sweep erases the idle matchers
+  ** that hold no orders and never traded, and returns the spare queue
+  ** capacity of the idle ones that still hold orders. A matcher that traded
+  ** is kept even when empty: its last price still triggers the stops placed
+  ** later and its statistics are still reported. Only what idle symbols own
+  ** is returned; the order map and the results buffer, shared with the
+  ** active symbols, are left alone.
+  */
+  void setReclaimPolicy(uint64_t idle_actions) {
+    _reclaim_after = idle_actions;
+    _last_sweep = _actions;
+  }
+
+  // Changes whenever an order is placed, filled or cancelled, or an empty matcher is reclaimed
+  auto version() const -> uint64_t {
+    return _version;
+  }
+
+  // Changes whenever an order of symbol is placed, filled or cancelled, or its
+  // empty matcher is reclaimed; 0 while it has no matcher
+  auto version(Symbol const & symbol) const -> uint64_t {
+    auto it = _matchers.find(symbol);
+    return it == _matchers.end() ? 0 : it->second.version();
+  }
+
+  auto order(OrderID id) const -> Order const * {
+    auto it = _orders.find(id);
+    return it == _orders.end() ? nullptr : &it->second;
+  }
+
+  auto matcher(Symbol const & symbol) const -> OrderMatcher const * {
+    auto it = _matchers.find(symbol);
+    return it == _matchers.end() ? nullptr : &it->second;
+  }
+
+  auto symbolCount() const -> size_t {
+    return _matchers.size();
+  }
+
+  // Memory of one symbol, zero if it has no matcher; O(levels)
+  auto memoryUsage(Symbol const & symbol) const -> MemoryUsage {
+    auto it = _matchers.find(symbol);
+    return it == _matchers.end() ? MemoryUsage() : it->second.memoryUsage();
+  }
+
+  // Memory of the whole book, with what is not owned by any symbol as `book`
+  auto memoryUsage() const -> MemoryUsage {
+    MemoryUsage usage;
+    for (auto const & [symbol, matcher] : _matchers) {
+      usage += matcher.memoryUsage();
+    }
+    usage.book += _orders.bucket_count() * sizeof(void *);
+    usage.book += _matchers.bucket_count() * sizeof(void *);
+    usage.book += _matchers.size() * (HASH_NODE_OVERHEAD + sizeof(std::pair<Symbol const, OrderMatcher>));
+    usage.book += _by_symbol.size() * (TREE_NODE_OVERHEAD + sizeof(std::pair<std::string_view const, OrderMatcher *>));
+    usage.book += _results.capacity() * sizeof(Result);
+    return usage;
+  }
+
+  // Reports the bytes used by the whole book, or by one symbol if given
+  void printMemory(Symbol const & symbol) {
+    beginAction_();
+    auto whole = symbol.view().empty();
+    auto usage = whole ? memoryUsage() : memoryUsage(symbol);
+    _results.emplace_back(Result::MemoryUsage(symbol, "levels", usage.levels));
+    _results.emplace_back(Result::MemoryUsage(symbol, "orders", usage.orders));
+    _results.emplace_back(Result::MemoryUsage(symbol, "queues", usage.queues));
+    if (whole) {
+      _results.emplace_back(Result::MemoryUsage(symbol, "book", usage.book));
+    }
+  }
+
+ private:
+  // Results of the previous action are dropped first
+  auto beginAction_() -> void {
     _results.clear();
-    for (auto it = _matchers.begin(); it != _matchers.end(); ++it) {
-      it->second.print(_results);
+    ++_actions;
+    if (_reclaim_after && _actions - _last_sweep >= _reclaim_after) {
+      reclaim_();
+    }
+  }
+
+  auto reclaim_() -> void {
+    auto erased = false;
+    for (auto it = _matchers.begin(); it != _matchers.end();) {
+      auto & matcher = it->second;
+      if (matcher.lastActive() + _reclaim_after > _actions) {
+        ++it;
+        continue;
+      }
+      // Kept while a delta dump still has to report its orders as removed
+      if (matcher.empty() && !matcher.traded() && !matcher.deltaPending()) {
+        _by_symbol.erase(it->first.view());
+        it = _matchers.erase(it);
+        erased = true;
+        continue;
+      }
+      // Only compacted once, by the first sweep that finds it idle
+      if (matcher.lastActive() + _reclaim_after > _last_sweep) {
+        matcher.compact();
+      }
+      ++it;
     }
+    if (erased) {
+      ++_version;
+    }
+    _last_sweep = _actions;
   }
 
+  // A mass cancel released orders of matcher
+  auto changed_(OrderMatcher & matcher) -> void {
+    ++_version;
+    matcher.markChanged(_version);
+  }
 };
 
 
@@ -1,6 +1,14 @@
 #pragma once
 #include <map>
+#include <memory_resource>
+#include <vector>
+#include <algorithm>
+#include <optional>
 #include "basic_types.hpp"
+#include "BookHash.hpp"
+#include "Generator.hpp"
+#include "TradeStats.hpp"
+#include "TradeTape.hpp"
 #include <unordered_map>
 
 namespace hft {
@@ -8,91 +16,645 @@ namespace hft {
 using hft::Order;
 using hft::Result;
 
+/*
+** A resting order as stored in its price level: only what the fill loops
+** touch. Symbol, side and price are the same for the whole level and live,
+** with the time priority, in the order map, which is only consulted to cancel
+** an order or to take it off the book hash.
+*/
+struct RestingOrder
+{
+  OrderID id;
+  Quantity quantity;  // open quantity
+};
+static_assert(sizeof(RestingOrder) == 8);
+
+/*
+** The containers of a book allocate from the memory resource of its order map
+** (see MultiSymbolBook and HugePageArena.hpp), the default heap unless given.
+*/
+using OrderMap = std::pmr::unordered_map<OrderID, Order>;
+
+/*
+** The orders resting at one price in time priority, with their total open
+** quantity so that the liquidity of a level is known without walking it.
+** Allocator-aware, so that a level takes the memory resource of its map.
+*/
+struct Level
+{
+  using allocator_type = std::pmr::polymorphic_allocator<RestingOrder>;
+
+  std::pmr::vector<RestingOrder> orders;
+  uint64_t quantity{0};  // sum of the open quantities of orders
+  bool dirty{false};     // changed since the last delta dump (see OrderMatcher::printDelta)
+
+  Level() = default;
+  Level(Level const &) = default;
+  Level(Level &&) = default;
+  auto operator=(Level const &) -> Level & = default;
+  auto operator=(Level &&) -> Level & = default;
+  explicit Level(allocator_type alloc) : orders(alloc) {}
+  Level(Level const & other, allocator_type alloc)
+      : orders(other.orders, alloc), quantity(other.quantity), dirty(other.dirty) {}
+  Level(Level && other, allocator_type alloc)
+      : orders(std::move(other.orders), alloc), quantity(other.quantity), dirty(other.dirty) {}
+
+  auto push(RestingOrder resting) -> void {
+    orders.push_back(resting);
+    quantity += resting.quantity;
+  }
+};
+// The queue of a level or of a stop price
+auto queueOf(Level const & level) -> std::pmr::vector<RestingOrder> const & { return level.orders; }
+auto queueOf(std::pmr::vector<OrderID> const & ids) -> std::pmr::vector<OrderID> const & { return ids; }
+
+using BuyLevels = std::pmr::map<Price, Level, std::greater<Price>>;
+using SellLevels = std::pmr::map<Price, Level>;
+
+/*
+** Pending stop orders by stop price, FIFO within a price. Each side is sorted
+** so that the stops a trade at price p crosses are a prefix: buy stops at or
+** below p, sell stops at or above p.
+*/
+using BuyStops = std::pmr::map<Price, std::pmr::vector<OrderID>>;
+using SellStops = std::pmr::map<Price, std::pmr::vector<OrderID>, std::greater<Price>>;
+
+/*
+** What the delta dumps of one side need: the levels as the last dump reported
+** them, and the prices of the levels changed since (a price may be listed
+** twice if its level was removed and created again).
+*/
+struct DeltaSide
+{
+  std::pmr::map<Price, std::pmr::vector<RestingOrder>> dumped;
+  std::pmr::vector<Price> dirty;
+
+  explicit DeltaSide(std::pmr::memory_resource * resource) : dumped(resource), dirty(resource) {}
+};
+
+/*
+** Bytes held by a book, estimated from the sizes and capacities of its
+** containers. Tree and hash nodes are counted as their value plus the
+** pointers libstdc++ keeps with it; allocator headers are not counted.
+*/
+struct MemoryUsage
+{
+  size_t levels{0};  // price level and stop price tree nodes
+  size_t orders{0};  // order map nodes
+  size_t queues{0};  // level and stop queues, trigger queue, trade bars, delta dump state
+  size_t book{0};    // MultiSymbolBook only: hash map buckets, matcher nodes, results
+
+  auto operator+=(MemoryUsage const & other) -> MemoryUsage & {
+    levels += other.levels;
+    orders += other.orders;
+    queues += other.queues;
+    book += other.book;
+    return *this;
+  }
+};
+
+// Color, parent, left and right of a red-black tree node
+constexpr size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+// Next pointer of a hash map node
+constexpr size_t HASH_NODE_OVERHEAD = sizeof(void *);
+
 class OrderMatcher {
 
-  std::unordered_map<OrderID, Order> & _orders;
-  std::map<Price,std::vector<OrderID>, std::greater<Price>> _buy;
-  std::map<Price,std::vector<OrderID>> _sell;
+  OrderMap & _orders;
+  BuyLevels _buy;
+  SellLevels _sell;
   Symbol _symbol;
+  uint64_t _symbol_key;
+  uint64_t _next_seq{0};
+  // BookHash.hpp sums of the resting orders of each side
+  uint64_t _buy_hash{0};
+  uint64_t _sell_hash{0};
+  BuyStops _buy_stops;
+  SellStops _sell_stops;
+  std::optional<Price> _last_price;  // of the latest trade
+  std::pmr::vector<OrderID> _triggered;  // stops waiting to be executed, in trigger order
+  TradeStats _stats;
+  TradeTape * _tape{nullptr};
+  uint64_t _last_active{0};  // MultiSymbolBook's action count
+  uint64_t _version{0};      // MultiSymbolBook's version at the last change to the orders
+  bool _tracking{false};     // dirty levels are tracked once there was a delta dump
+  DeltaSide _buy_delta;
+  DeltaSide _sell_delta;
 
  public:
-  OrderMatcher(std::unordered_map<OrderID, Order> & orders, Symbol symbol)
-      : _orders(orders), _symbol(symbol)
+  OrderMatcher(OrderMap & orders, Symbol symbol)
+      : _orders(orders),
+        _buy(orders.get_allocator().resource()),
+        _sell(orders.get_allocator().resource()),
+        _symbol(symbol),
+        _symbol_key(symbolKey(symbol)),
+        _buy_stops(orders.get_allocator().resource()),
+        _sell_stops(orders.get_allocator().resource()),
+        _triggered(orders.get_allocator().resource()),
+        _buy_delta(orders.get_allocator().resource()),
+        _sell_delta(orders.get_allocator().resource())
   {}
 
+  // Orders that leave the book (filled or cancelled) are erased from the order map.
+  // IOC and FOK orders never rest: what they do not fill at once is cancelled,
+  // and a FOK the opposite levels cannot fill in full is cancelled untouched.
+  // Stop orders wait off the book until a trade crosses their stop price; the
+  // stops triggered by an add are executed in the same call (see runStops_)
   void add(OrderID iorder , std::vector<Result> & results);
   void cancel(OrderID iorder, std::vector<Result> & results);
+  // Releases every order of one side (or both), best level first, FIFO within a
+  // level, then the side's pending stops in trigger order
+  void cancelSide(Side side, std::vector<Result> & results);
+  void cancelAll(std::vector<Result> & results);
+  // The resting orders as BookEntry results, buys best-first then sells, FIFO
+  // within a level, produced one at a time; the book must not change until
+  // the walk is over
+  auto entries() const -> Generator<Result>;
   void print(std::vector<Result> & results) const;
+  /*
+  ** Reports the resting orders that were added, changed or removed since the
+  ** previous call, as BookDelta results with the open quantity (0 once the
+  ** order left the book); the first call reports the whole book. Only the
+  ** levels marked dirty by an add, fill or cancel are compared, so the cost
+  ** is that of the changed levels, not of the book.
+  */
+  void printDelta(std::vector<Result> & results);
+  // The last delta dump reported orders, so the next one has removals to report
+  // if they have left the book
+  auto deltaPending() const -> bool { return !_buy_delta.dumped.empty() || !_sell_delta.dumped.empty(); }
+  auto hash() const -> uint64_t { return _buy_hash + _sell_hash; }
+  auto tradeStats() const -> TradeStats const & { return _stats; }
+  auto configureBars(uint64_t trades_per_bar, size_t nbars) -> void { _stats.configureBars(trades_per_bar, nbars); }
+  // Records every trade on tape from now on, none if nullptr
+  auto setTape(TradeTape * tape) -> void { _tape = tape; }
+  // The session statistics, then the bars held, oldest first
+  void printStats(std::vector<Result> & results) const;
+
+  // No resting orders and no pending stops
+  auto empty() const -> bool;
+  // A trade happened: there is a last price for the stops and statistics to report
+  auto traded() const -> bool { return _last_price.has_value(); }
+  // Walks the levels, O(levels)
+  auto memoryUsage() const -> MemoryUsage;
+  // Returns the spare capacity of the level, stop and dirty level queues
+  auto compact() -> void;
+  auto touch(uint64_t now) -> void { _last_active = now; }
+  // Best level first, for readers such as BookFork
+  auto buyLevels() const -> BuyLevels const & { return _buy; }
+  auto sellLevels() const -> SellLevels const & { return _sell; }
+  auto lastActive() const -> uint64_t { return _last_active; }
+  auto markChanged(uint64_t version) -> void { _version = version; }
+  auto version() const -> uint64_t { return _version; }
+  // The opposite best level an order of side meets first, nullptr if there is
+  // none. Its address comes from the tree header, so finding it does not wait
+  // on the level itself (see MultiSymbolBook::prefetchAdd)
+  auto bestOpposite(Side side) const -> Level const *;
 
  private:
+  auto execute_(Order & order, std::vector<Result> & results) -> void;
   auto tryBuy_(Order & buy, std::vector<Result> & results) -> void;
   auto trySell_(Order & sell, std::vector<Result> & results) -> void;
+  auto confirmIncoming_(Order const & incoming, Quantity filled, size_t first_fill,
+                        std::vector<Result> & results) -> void;
+  auto runStops_(std::vector<Result> & results) -> void;
+  auto collectStops_() -> void;
+  template <typename Stops>
+  auto takeStops_(Stops & stops, typename Stops::iterator last) -> void;
+  template <typename Stops>
+  auto removeStop_(Stops & stops, Order const & order) -> void;
+  template <typename Stops>
+  auto releaseStops_(Stops & stops, std::vector<Result> & results) -> void;
+  template <typename Levels>
+  auto sweepLevel_(Levels & levels, Order & incoming, std::vector<Result> & results) -> bool;
+  auto canFill_(Order const & order) const -> bool;
+  template <typename Levels>
+  auto liquidity_(Levels const & levels, Order const & order) const -> bool;
+  auto settleFills_(std::vector<Result> const & results, size_t first, bool last_partial, uint64_t & hash) -> void;
+  auto nextSeq_() -> uint64_t;
+  template <typename Levels>
+  auto removeResting_(Levels & levels, Order const & order) -> Quantity;
+  template <typename Levels>
+  auto releaseLevels_(Levels & levels, std::vector<Result> & results) -> void;
+  template <typename Queues>
+  auto queuesUsage_(Queues const & queues, MemoryUsage & usage) const -> void;
+  auto deltaOf_(BuyLevels const &) -> DeltaSide & { return _buy_delta; }
+  auto deltaOf_(SellLevels const &) -> DeltaSide & { return _sell_delta; }
+  template <typename Levels>
+  auto markDirty_(Levels & levels, Level & level, Price price) -> void;
+  template <typename Levels>
+  auto deltaSide_(Levels & levels, std::vector<Result> & results) -> void;
 };
 
 auto OrderMatcher::add(OrderID id, std::vector<Result> & results) -> void {
-  if (!_orders.count(id)) {
+  auto it = _orders.find(id);
+  if (it == _orders.end()) {
     throw std::invalid_argument("Invalid order index");
   }
 
-  auto & order = _orders[id];
-  if (order.side == Side::Buy) {
-    tryBuy_(order, results);
-    if (order.quantity) {
-      _buy[order.price].push_back(id);
+  auto & order = it->second;
+  if (order.type == OrderType::Stop || order.type == OrderType::StopLimit) {
+    // A stop the last trade has already crossed is taken straight back out
+    // of the index by runStops_ and executed
+    if (order.side == Side::Buy) {
+      _buy_stops[order.stop_price].push_back(id);
+    }
+    else {
+      _sell_stops[order.stop_price].push_back(id);
     }
   }
   else {
-    trySell_(order, results);
-    if (order.quantity) {
-      _sell[order.price].push_back(id);
+    execute_(order, results);
+  }
+  runStops_(results);
+}
+
+// Matches a limit or market order and rests what is left of a GTC limit order
+auto OrderMatcher::execute_(Order & order, std::vector<Result> & results) -> void
+{
+  // A FOK the book cannot fill is killed before touching it
+  bool killed = order.tif == TimeInForce::FOK && !canFill_(order);
+  if (!killed) {
+    if (order.side == Side::Buy) {
+      tryBuy_(order, results);
     }
+    else {
+      trySell_(order, results);
+    }
+  }
+  if (order.quantity && (order.type == OrderType::Market || order.tif != TimeInForce::GTC)) {
+    order.quantity = 0;
+    results.emplace_back(Result::CancelConfirm(order.id, _symbol));
   }
+  if (!order.quantity) {
+    _orders.erase(order.id);
+  }
+  else if (order.side == Side::Buy) {
+    order.seq = nextSeq_();
+    _buy_hash += orderKey(order, _symbol_key) * order.quantity;
+    auto & level = _buy[order.price];
+    level.push({order.id, order.quantity});
+    markDirty_(_buy, level, order.price);
+  }
+  else {
+    order.seq = nextSeq_();
+    _sell_hash += orderKey(order, _symbol_key) * order.quantity;
+    auto & level = _sell[order.price];
+    level.push({order.id, order.quantity});
+    markDirty_(_sell, level, order.price);
+  }
+}
+
+// Whether the opposite side holds the order's whole quantity at prices it crosses
+auto OrderMatcher::canFill_(Order const & order) const -> bool
+{
+  return order.side == Side::Buy ? liquidity_(_sell, order) : liquidity_(_buy, order);
+}
+
+// Sums level totals best first, so it visits only the levels the order would cross
+template <typename Levels>
+auto OrderMatcher::liquidity_(Levels const & levels, Order const & order) const -> bool
+{
+  auto const better = levels.key_comp();
+  uint64_t available = 0;
+  for (auto it = levels.begin(); it != levels.end() && !better(order.price, it->first); ++it) {
+    available += it->second.quantity;
+    if (available >= order.quantity) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+** Executes the stops crossed by the last trade price, and keeps going while
+** the trades they make cross more stops. Stops crossed by the same trade run
+** buys first, each side in trigger-price order (lowest buy stop first, highest
+** sell stop first) and FIFO within a price; stops crossed later queue behind
+** them. Only the crossed prefix of each index is ever visited.
+*/
+auto OrderMatcher::runStops_(std::vector<Result> & results) -> void
+{
+  collectStops_();
+  for (size_t i = 0; i < _triggered.size(); ++i) {
+    auto & order = _orders.find(_triggered[i])->second;
+    if (order.type == OrderType::Stop) {
+      order.type = OrderType::Market;
+      // Crosses any opposite level; market fills happen at the resting price
+      order.price = order.side == Side::Buy ? Price::max() : Price(0);
+    }
+    else {
+      order.type = OrderType::Limit;
+    }
+    execute_(order, results);
+    collectStops_();
+  }
+  _triggered.clear();
+}
+
+auto OrderMatcher::collectStops_() -> void
+{
+  if (!_last_price) {
+    return;
+  }
+  takeStops_(_buy_stops, _buy_stops.upper_bound(*_last_price));
+  takeStops_(_sell_stops, _sell_stops.upper_bound(*_last_price));
+}
+
+// Moves the stops in [begin, last) to the trigger queue
+template <typename Stops>
+auto OrderMatcher::takeStops_(Stops & stops, typename Stops::iterator last) -> void
+{
+  for (auto it = stops.begin(); it != last; ++it) {
+    _triggered.insert(_triggered.end(), it->second.begin(), it->second.end());
+  }
+  stops.erase(stops.begin(), last);
+}
+
+// Time priority only orders resting orders among themselves, so it restarts
+// whenever the book is empty and the hash does not depend on older history
+auto OrderMatcher::nextSeq_() -> uint64_t
+{
+  if (_buy.empty() && _sell.empty()) {
+    _next_seq = 0;
+  }
+  return _next_seq++;
 }
 
 void OrderMatcher::cancel(OrderID id, std::vector<Result> & results)
 {
-  if (!_orders.count(id)) {
+  auto it = _orders.find(id);
+  if (it == _orders.end()) {
     results.emplace_back(Result::Error(id, "Order does not exist"));
     return;
   }
-  auto & order = _orders[id];
-  if (order.side == Side::Buy) {
-    auto & buys_with_price = _buy[order.price];
-    auto it = std::find(buys_with_price.begin(), buys_with_price.end(), id);
-    buys_with_price.erase(it);
-    if (buys_with_price.empty()) {
-      _buy.erase(order.price);
+  auto & order = it->second;
+  if (order.type == OrderType::Stop || order.type == OrderType::StopLimit) {
+    if (order.side == Side::Buy) {
+      removeStop_(_buy_stops, order);
     }
+    else {
+      removeStop_(_sell_stops, order);
+    }
+  }
+  else if (order.side == Side::Buy) {
+    _buy_hash -= orderKey(order, _symbol_key) * removeResting_(_buy, order);
   }
   else {
-    auto & sells_with_price = _sell[order.price];
-    auto it = std::find(sells_with_price.begin(), sells_with_price.end(), id);
-    sells_with_price.erase(it);
-    if (sells_with_price.empty()) {
-      _sell.erase(order.price);
-    }
+    _sell_hash -= orderKey(order, _symbol_key) * removeResting_(_sell, order);
   }
+  _orders.erase(it);
   results.emplace_back(Result::CancelConfirm(id, _symbol));
 }
 
-void OrderMatcher::print(std::vector<Result> & results) const
+// Takes the order out of its level and returns its open quantity
+template <typename Levels>
+auto OrderMatcher::removeResting_(Levels & levels, Order const & order) -> Quantity
+{
+  auto level = levels.find(order.price);
+  auto & resting = level->second.orders;
+  auto it = std::find_if(resting.begin(), resting.end(), [&](RestingOrder const & r) {
+    return r.id == order.id;
+  });
+  auto quantity = it->quantity;
+  level->second.quantity -= quantity;
+  markDirty_(levels, level->second, level->first);
+  resting.erase(it);
+  if (resting.empty()) {
+    levels.erase(level);
+  }
+  return quantity;
+}
+
+template <typename Stops>
+auto OrderMatcher::removeStop_(Stops & stops, Order const & order) -> void
+{
+  auto level = stops.find(order.stop_price);
+  auto & ids = level->second;
+  ids.erase(std::find(ids.begin(), ids.end(), order.id));
+  if (ids.empty()) {
+    stops.erase(level);
+  }
+}
+
+void OrderMatcher::cancelSide(Side side, std::vector<Result> & results)
+{
+  if (side == Side::Buy) {
+    releaseLevels_(_buy, results);
+    releaseStops_(_buy_stops, results);
+    _buy_hash = 0;
+  }
+  else {
+    releaseLevels_(_sell, results);
+    releaseStops_(_sell_stops, results);
+    _sell_hash = 0;
+  }
+}
+
+void OrderMatcher::cancelAll(std::vector<Result> & results)
+{
+  releaseLevels_(_buy, results);
+  releaseLevels_(_sell, results);
+  releaseStops_(_buy_stops, results);
+  releaseStops_(_sell_stops, results);
+  _buy_hash = 0;
+  _sell_hash = 0;
+}
+
+template <typename Stops>
+auto OrderMatcher::releaseStops_(Stops & stops, std::vector<Result> & results) -> void
+{
+  for (auto const & it : stops) {
+    for (auto id : it.second) {
+      results.emplace_back(Result::CancelConfirm(id, _symbol));
+      _orders.erase(id);
+    }
+  }
+  stops.clear();
+}
+
+template <typename Levels>
+auto OrderMatcher::releaseLevels_(Levels & levels, std::vector<Result> & results) -> void
+{
+  for (auto & it : levels) {
+    markDirty_(levels, it.second, it.first);
+    for (auto const & resting : it.second.orders) {
+      results.emplace_back(Result::CancelConfirm(resting.id, _symbol));
+      _orders.erase(resting.id);
+    }
+  }
+  levels.clear();
+}
+
+void OrderMatcher::printStats(std::vector<Result> & results) const
+{
+  results.emplace_back(Result::TradeStats(_symbol, _stats.session()));
+  for (auto i = _stats.firstBar(); i < _stats.endBar(); ++i) {
+    results.emplace_back(Result::TradeBar(_symbol, static_cast<OrderID>(i), _stats.bar(i)));
+  }
+}
+
+auto OrderMatcher::empty() const -> bool
+{
+  return _buy.empty() && _sell.empty() && _buy_stops.empty() && _sell_stops.empty();
+}
+
+auto OrderMatcher::memoryUsage() const -> MemoryUsage
+{
+  MemoryUsage usage;
+  queuesUsage_(_buy, usage);
+  queuesUsage_(_sell, usage);
+  queuesUsage_(_buy_stops, usage);
+  queuesUsage_(_sell_stops, usage);
+  usage.queues += _triggered.capacity() * sizeof(OrderID);
+  usage.queues += _stats.barBytes();
+  for (auto const * delta : {&_buy_delta, &_sell_delta}) {
+    using Node = decltype(delta->dumped)::value_type;
+    for (auto const & [price, orders] : delta->dumped) {
+      usage.levels += TREE_NODE_OVERHEAD + sizeof(Node);
+      usage.queues += orders.capacity() * sizeof(RestingOrder);
+    }
+    usage.queues += delta->dirty.capacity() * sizeof(Price);
+  }
+  return usage;
+}
+
+// Tree nodes, queue capacity and the orders queued, of a level or stop map
+template <typename Queues>
+auto OrderMatcher::queuesUsage_(Queues const & queues, MemoryUsage & usage) const -> void
+{
+  using Node = typename Queues::value_type;
+  for (auto const & [price, entry] : queues) {
+    auto const & queue = queueOf(entry);
+    usage.levels += TREE_NODE_OVERHEAD + sizeof(Node);
+    usage.queues += queue.capacity() * sizeof(typename std::decay_t<decltype(queue)>::value_type);
+    usage.orders += queue.size() * (HASH_NODE_OVERHEAD + sizeof(std::pair<OrderID const, Order>));
+  }
+}
+
+auto OrderMatcher::compact() -> void
+{
+  for (auto & [price, level] : _buy) {
+    level.orders.shrink_to_fit();
+  }
+  for (auto & [price, level] : _sell) {
+    level.orders.shrink_to_fit();
+  }
+  for (auto & [price, ids] : _buy_stops) {
+    ids.shrink_to_fit();
+  }
+  for (auto & [price, ids] : _sell_stops) {
+    ids.shrink_to_fit();
+  }
+  _triggered.shrink_to_fit();
+  _buy_delta.dirty.shrink_to_fit();
+  _sell_delta.dirty.shrink_to_fit();
+}
+
+auto OrderMatcher::entries() const -> Generator<Result>
 {
   // Cannot do those in a single loo for (auto & container : {_buy, _sell})
   // because those maps use different comparators
   for (auto const & it : _buy) {
-    for (auto order_id : it.second) {
-      auto & order = _orders[order_id];
-      results.emplace_back(Result::BookEntry(order_id, _symbol, order.quantity, order.price) );
+    for (auto const & resting : it.second.orders) {
+      co_yield Result::BookEntry(resting.id, _symbol, resting.quantity, it.first);
     }
   }
   for (auto const & it : _sell) {
-    for (auto order_id : it.second) {
-      auto & order = _orders[order_id];
-      results.emplace_back(Result::BookEntry(order_id, _symbol, order.quantity, order.price) );
+    for (auto const & resting : it.second.orders) {
+      co_yield Result::BookEntry(resting.id, _symbol, resting.quantity, it.first);
     }
   }
 }
 
+void OrderMatcher::print(std::vector<Result> & results) const
+{
+  for (auto const & entry : entries()) {
+    results.push_back(entry);
+  }
+}
+
+auto OrderMatcher::bestOpposite(Side side) const -> Level const *
+{
+  if (side == Side::Buy) {
+    return _sell.empty() ? nullptr : &_sell.begin()->second;
+  }
+  return _buy.empty() ? nullptr : &_buy.begin()->second;
+}
+
+void OrderMatcher::printDelta(std::vector<Result> & results)
+{
+  if (!_tracking) {
+    // Nothing was reported yet, so every level is new
+    _tracking = true;
+    for (auto & [price, level] : _buy) {
+      markDirty_(_buy, level, price);
+    }
+    for (auto & [price, level] : _sell) {
+      markDirty_(_sell, level, price);
+    }
+  }
+  deltaSide_(_buy, results);
+  deltaSide_(_sell, results);
+}
+
+template <typename Levels>
+auto OrderMatcher::markDirty_(Levels & levels, Level & level, Price price) -> void
+{
+  if (_tracking && !level.dirty) {
+    level.dirty = true;
+    deltaOf_(levels).dirty.push_back(price);
+  }
+}
+
+/*
+** Compares each dirty level with what the last dump reported, best level
+** first. Orders only join a level at the back and keep their relative order,
+** so one merge-like walk of both queues finds the differences.
+*/
+template <typename Levels>
+auto OrderMatcher::deltaSide_(Levels & levels, std::vector<Result> & results) -> void
+{
+  static std::pmr::vector<RestingOrder> const no_orders;
+  auto & delta = deltaOf_(levels);
+  auto & dirty = delta.dirty;
+  std::sort(dirty.begin(), dirty.end(), levels.key_comp());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+  for (auto price : dirty) {
+    auto level = levels.find(price);
+    auto dumped = delta.dumped.find(price);
+    auto const & before = dumped == delta.dumped.end() ? no_orders : dumped->second;
+    auto const & after = level == levels.end() ? no_orders : level->second.orders;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < before.size() || j < after.size()) {
+      if (i < before.size() && j < after.size() && before[i].id == after[j].id) {
+        if (before[i].quantity != after[j].quantity) {
+          results.emplace_back(Result::BookDelta(after[j].id, _symbol, after[j].quantity, price));
+        }
+        ++i;
+        ++j;
+      }
+      else if (i < before.size()) {
+        results.emplace_back(Result::BookDelta(before[i++].id, _symbol, 0, price));
+      }
+      else {
+        results.emplace_back(Result::BookDelta(after[j].id, _symbol, after[j].quantity, price));
+        ++j;
+      }
+    }
+    if (level == levels.end()) {
+      if (dumped != delta.dumped.end()) {
+        delta.dumped.erase(dumped);
+      }
+    }
+    else {
+      level->second.dirty = false;
+      delta.dumped.try_emplace(price).first->second.assign(after.begin(), after.end());
+    }
+  }
+  dirty.clear();
+}
+
 auto OrderMatcher::tryBuy_(Order &buy, std::vector<Result> &results) -> void
 {
   /*
@@ -110,51 +672,101 @@ auto OrderMatcher::tryBuy_(Order &buy, std::vector<Result> &results) -> void
   ** the 100 shares buy order matching will start.
   */
   auto old_quantity = buy.quantity;
+  auto first_fill = results.size();
+  bool partial = false;
   while (buy.quantity && !_sell.empty() && buy.price >= _sell.begin()->first) {
-    auto &cheapest_sells = _sell.begin()->second;
-    auto earliest_sell = cheapest_sells.front();
-    auto &sell = _orders[earliest_sell];
-
-    Quantity fill_quantity = std::min(sell.quantity, buy.quantity);
-    results.emplace_back(Result::FillConfirm(sell.id, _symbol, fill_quantity, buy.price));
-    sell.quantity -= fill_quantity;
-    buy.quantity -= fill_quantity;
-
-    if (!sell.quantity) {
-      cheapest_sells.erase(cheapest_sells.begin());
-      if (cheapest_sells.empty()) {
-        _sell.erase(_sell.begin());
-      }
-    }
-  }
-  if (buy.quantity < old_quantity) {
-    results.emplace_back(Result::FillConfirm(buy.id, _symbol, old_quantity - buy.quantity, buy.price));
+    partial = sweepLevel_(_sell, buy, results);
   }
+  settleFills_(results, first_fill, partial, _sell_hash);
+  confirmIncoming_(buy, old_quantity - buy.quantity, first_fill, results);
 }
 
 auto OrderMatcher::trySell_(Order &sell, std::vector<Result> &results) -> void
 {
   auto old_quantity = sell.quantity;
+  auto first_fill = results.size();
+  bool partial = false;
   while (sell.quantity && !_buy.empty() && sell.price <= _buy.begin()->first) {
-    auto & highest_buys = _buy.begin()->second;
-    auto earliest_buy = highest_buys.front();
-    auto & buy = _orders[earliest_buy];
-
-    Quantity fill_quantity = std::min(sell.quantity, buy.quantity);
-    results.emplace_back(Result::FillConfirm(buy.id, _symbol, fill_quantity, sell.price));
-    sell.quantity -= fill_quantity;
-    buy.quantity -= fill_quantity;
-
-    if (!buy.quantity) {
-      highest_buys.erase(highest_buys.begin());
-      if (highest_buys.empty()) {
-        _buy.erase(_buy.begin());
-      }
+    partial = sweepLevel_(_buy, sell, results);
+  }
+  settleFills_(results, first_fill, partial, _buy_hash);
+  confirmIncoming_(sell, old_quantity - sell.quantity, first_fill, results);
+}
+
+/*
+** Reports the incoming order's fills after the resting ones in results[first_fill..]
+** and records the last trade price. A limit order fills at its own price and
+** gets one confirmation; a market order gets one per level it swept.
+*/
+auto OrderMatcher::confirmIncoming_(Order const & incoming, Quantity filled, size_t first_fill,
+                                    std::vector<Result> & results) -> void
+{
+  if (!filled) {
+    return;
+  }
+  auto last_fill = results.size();
+  _last_price = results[last_fill - 1].price;
+  if (incoming.type != OrderType::Market) {
+    results.emplace_back(Result::FillConfirm(incoming.id, _symbol, filled, incoming.price));
+    return;
+  }
+  for (auto i = first_fill; i < last_fill;) {
+    auto price = results[i].price;
+    Quantity quantity = 0;
+    for (; i < last_fill && results[i].price == price; ++i) {
+      quantity += results[i].quantity;
     }
+    results.emplace_back(Result::FillConfirm(incoming.id, _symbol, quantity, price));
   }
+}
+
+/*
+** Fills the incoming order against the best level in time priority, at the
+** incoming order's price (the level's for a market order). Filled orders are dropped from the front of the
+** level in one go. Returns whether the last order touched was only partially
+** filled (and so stays in the book).
+*/
+template <typename Levels>
+auto OrderMatcher::sweepLevel_(Levels & levels, Order & incoming, std::vector<Result> & results) -> bool
+{
+  markDirty_(levels, levels.begin()->second, levels.begin()->first);
+  auto & level = levels.begin()->second.orders;
+  auto price = incoming.type == OrderType::Market ? levels.begin()->first : incoming.price;
+  auto resting = level.begin();
+  bool partial = false;
+  for (; resting != level.end() && incoming.quantity; ++resting) {
+    Quantity fill_quantity = std::min(resting->quantity, incoming.quantity);
+    levels.begin()->second.quantity -= fill_quantity;
+    results.emplace_back(Result::FillConfirm(resting->id, _symbol, fill_quantity, price));
+    _stats.add(price, fill_quantity);
+    if (_tape) {
+      _tape->record(_symbol, resting->id, incoming.id, fill_quantity, price);
+    }
+    resting->quantity -= fill_quantity;
+    incoming.quantity -= fill_quantity;
+    if (resting->quantity) {
+      partial = true;
+      break;
+    }
+  }
+  level.erase(level.begin(), resting);
+  if (level.empty()) {
+    levels.erase(levels.begin());
+  }
+  return partial;
+}
 
-  if (sell.quantity < old_quantity) {
-    results.emplace_back(Result::FillConfirm(sell.id, _symbol, old_quantity - sell.quantity, sell.price));
+// Takes the resting orders filled by results[first..] off the side's hash and
+// erases the ones that were filled completely from the order map
+auto OrderMatcher::settleFills_(std::vector<Result> const & results, size_t first,
+                                bool last_partial, uint64_t & hash) -> void
+{
+  for (auto i = first; i < results.size(); ++i) {
+    auto it = _orders.find(results[i].order_id);
+    hash -= orderKey(it->second, _symbol_key) * results[i].quantity;
+    if (!last_partial || i + 1 < results.size()) {
+      _orders.erase(it);
+    }
   }
 }
 
@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ActionBatch.hpp"
+#include "FieldDecode.hpp"
+#include "ThreadTuning.hpp"
+
+/*
+** Timestamped sessions and their replay at the pace they arrived.
+**
+** A capture is an actions file with the arrival time of each line in front:
+**
+**   ARRIVAL_NS ACTION...
+**   1697040000123456789 O 1 IBM B 10 100.00000
+**
+** ARRIVAL_NS is an unsigned count of nanoseconds that never decreases; only
+** the differences between lines matter. SessionCapture writes one (app
+** --capture) with the steady clock.
+**
+** PacedReplay schedules line i at start + (arrival_i - arrival_0) / speed
+** and runs it through a MultiSymbolBook once that time has come, or at once
+** if the book is still busy with earlier lines. The latency of a line is
+** from its scheduled arrival to the moment its results are formatted, so it
+** includes the time spent queued behind a burst. Lines closer than burst_gap
+** in the capture form a burst, and the latencies are reported per burst.
+*/
+namespace hft {
+
+struct TimedAction
+{
+  uint64_t arrival_ns;
+  std::string line;  // the action, without the timestamp
+};
+
+// Writes stamped lines to a new capture file
+class SessionCapture {
+  std::ofstream _file;
+
+ public:
+  explicit SessionCapture(std::string const & path) : _file(path, std::ios::trunc)
+  {
+    if (!_file) {
+      throw std::runtime_error("Cannot open capture " + path);
+    }
+  }
+
+  auto record(std::string_view line, uint64_t arrival_ns) -> void
+  {
+    _file << arrival_ns << ' ' << line << '\n';
+  }
+
+  // Nanoseconds of the steady clock, for stamping lines as they arrive: unlike
+  // the system clock it never steps back, which readCapture would refuse
+  static auto now() -> uint64_t
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+};
+
+// Reads a capture; arrival times must not go backwards
+auto readCapture(std::istream & in) -> std::vector<TimedAction>
+{
+  std::vector<TimedAction> actions;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) continue;
+    auto space = line.find(' ');
+    uint64_t ns;
+    if (space == std::string::npos ||
+        decodeUnsigned(std::string_view(line).substr(0, space), ns) != DecodeStatus::Ok) {
+      throw std::invalid_argument("Invalid capture timestamp");
+    }
+    if (!actions.empty() && ns < actions.back().arrival_ns) {
+      throw std::invalid_argument("Capture timestamps go backwards");
+    }
+    actions.push_back({ns, line.substr(space + 1)});
+  }
+  return actions;
+}
+
+// q-quantile of sorted values, 0 if there are none
+auto percentile(std::vector<double> const & sorted, double q) -> double
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())))];
+}
+
+struct LatencySummary
+{
+  size_t actions{0};
+  double p50{0};
+  double p99{0};
+  double p999{0};
+  double max{0};
+
+  // Sorts latencies
+  static auto of(std::vector<double> & latencies) -> LatencySummary;
+};
+
+auto LatencySummary::of(std::vector<double> & latencies) -> LatencySummary
+{
+  std::sort(latencies.begin(), latencies.end());
+  return {latencies.size(), percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+          latencies.empty() ? 0 : latencies.back()};
+}
+
+// ACTIONS p50 P50 p99 P99 p999 P999 max MAX ns
+std::ostream& operator<<(std::ostream& os, LatencySummary const & s) {
+  os << s.actions << " p50 " << static_cast<uint64_t>(s.p50) << " p99 " << static_cast<uint64_t>(s.p99)
+     << " p999 " << static_cast<uint64_t>(s.p999) << " max " << static_cast<uint64_t>(s.max) << " ns";
+  return os;
+}
+
+struct BurstReport
+{
+  size_t first;         // index of its first line
+  uint64_t span_ns;     // capture time from its first to its last line
+  LatencySummary latency;
+};
+
+struct PaceReport
+{
+  std::vector<BurstReport> bursts;
+  LatencySummary all;
+};
+
+class PacedReplay {
+  double _speed;
+  uint64_t _burst_gap_ns;
+  WaitPolicy _wait;
+
+ public:
+  // speed 2 replays twice as fast as captured, 0 as fast as possible. Waits
+  // for a line's arrival sleep until shortly before it unless wait is Spin
+  explicit PacedReplay(double speed = 1, uint64_t burst_gap_ns = 1'000'000, WaitPolicy wait = WaitPolicy::Block)
+      : _speed(speed), _burst_gap_ns(burst_gap_ns), _wait(wait)
+  {}
+
+  // Replays actions against book and writes their results to out as app does
+  auto run(MultiSymbolBook & book, std::vector<TimedAction> const & actions, std::ostream & out) const
+      -> PaceReport;
+
+ private:
+  auto waitUntil_(std::chrono::steady_clock::time_point deadline) const -> void;
+};
+
+auto PacedReplay::waitUntil_(std::chrono::steady_clock::time_point deadline) const -> void
+{
+  constexpr auto spin_window = std::chrono::microseconds(100);
+  if (_wait == WaitPolicy::Block && deadline - std::chrono::steady_clock::now() > spin_window) {
+    std::this_thread::sleep_until(deadline - spin_window);
+  }
+  while (std::chrono::steady_clock::now() < deadline) {
+    cpuRelax();
+  }
+}
+
+auto PacedReplay::run(MultiSymbolBook & book, std::vector<TimedAction> const & actions, std::ostream & out) const
+    -> PaceReport
+{
+  // Results are formatted into memory so that writing them out does not pace the replay
+  std::ostringstream text;
+  std::vector<double> latencies(actions.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < actions.size(); ++i) {
+    auto offset = _speed > 0 ? static_cast<double>(actions[i].arrival_ns - actions[0].arrival_ns) / _speed : 0;
+    auto scheduled = start + std::chrono::nanoseconds(static_cast<int64_t>(offset));
+    waitUntil_(scheduled);
+    try {
+      execute(book, Action(actions[i].line), text);
+    }
+    catch (std::exception const & e) {
+      text << e.what() << '\n';
+    }
+    latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - scheduled).count();
+  }
+  out << text.view();
+
+  PaceReport report;
+  std::vector<double> burst;
+  for (size_t first = 0, i = 0; i < actions.size(); first = i) {
+    do {
+      ++i;
+    } while (i < actions.size() && actions[i].arrival_ns - actions[i - 1].arrival_ns <= _burst_gap_ns);
+    burst.assign(latencies.begin() + first, latencies.begin() + i);
+    report.bursts.push_back({first, actions[i - 1].arrival_ns - actions[first].arrival_ns, LatencySummary::of(burst)});
+  }
+  report.all = LatencySummary::of(latencies);
+  return report;
+}
+
+}  // end namespace hft
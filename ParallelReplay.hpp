@@ -0,0 +1,390 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Action.hpp"
+#include "ActionBatch.hpp"
+#include "MultiSymbolBook.hpp"
+#include "ThreadTuning.hpp"
+
+namespace hft {
+
+/*
+** Offline replay of an actions file, with symbols matched in parallel.
+**
+** Pass 1 parses every line and decides which partition owns it.
+**   - O lines belong to the group of their symbol. When an order id is reused
+**     on another symbol (legal once the first order has left the book), the two
+**     symbols are fused with a union-find, since whether the second O is a
+**     "Duplicate order id" depends on the state of the first symbol.
+**   - X lines follow the group of their order id. X of an id that is never
+**     placed anywhere in the file cannot succeed and is answered right away,
+**     as are lines that fail to parse.
+**   - C, H, M and D lines for one symbol, and T lines, follow that symbol's group.
+**   - P lines and book-wide C, H, M and D lines are broadcast to every partition.
+**   Groups are then packed into a bounded number of partitions, biggest first.
+** Pass 2 runs one MultiSymbolBook per partition on a pool of threads, pinned
+** as ThreadOptions say (see ThreadTuning.hpp). Workers take the next
+** partition until none is left and never wait on each other.
+** Pass 3 walks the lines in the original order and stitches the outputs.
+**
+** Broadcast merge rule: every partition runs the line against its own book
+** and the results are merged ordered by symbol. The order inside a symbol is
+** the one of OrderMatcher (buys best-first, then sells, FIFO inside a level).
+** That is what MultiSymbolBook::cancelAll, print and printDelta emit, so
+** runSequential is a reference to diff against as it is. A book-wide H sums
+** the partitions' hashes, which is the hash of the whole book (see
+** BookHash.hpp). A book-wide M sums every category over the partitions. The
+** levels, orders and queues belong to one symbol each, so they match a
+** sequential run; `book` is the sum of the partitions' own tables and
+** buffers, which is not what the single book of a sequential run holds.
+*/
+class ParallelReplay {
+  enum class RouteKind : uint8_t { Book, Broadcast, Local };
+
+  struct Route {
+    RouteKind kind;
+    uint32_t target;  // partition for Book, index into _local for Local
+  };
+
+  struct Partition {
+    std::vector<uint32_t> lines;        // line numbers, in file order
+    std::string text;                   // formatted output of non-P lines
+    std::vector<size_t> text_ends;      // end of each line's output in text
+    std::vector<Result> broadcast;      // results of broadcast lines
+    std::vector<size_t> broadcast_ends; // end of each line's results in broadcast
+  };
+
+  size_t _nthreads;
+  ThreadOptions _options;
+  std::vector<Action> _actions;
+  std::vector<Route> _routes;
+  std::vector<std::string> _local;     // output of lines that need no book
+  std::vector<Partition> _partitions;
+
+ public:
+  explicit ParallelReplay(size_t nthreads, ThreadOptions options = {})
+      : _nthreads(std::max<size_t>(nthreads, 1)), _options(std::move(options))
+  {}
+
+  auto run(std::vector<std::string> const & lines, std::ostream & out) -> void;
+  static auto runSequential(std::vector<std::string> const & lines, std::ostream & out) -> void;
+
+ private:
+  auto partition_(std::vector<std::string> const & lines) -> void;
+  auto match_(Partition & part) const -> void;
+  auto merge_(std::ostream & out) const -> void;
+  static auto isBroadcast_(Action const & action) -> bool;
+  static auto sortBySymbol_(std::vector<Result> & results) -> void;
+};
+
+// Union-find over symbol indices
+class SymbolGroups {
+  std::vector<uint32_t> _parent;
+
+ public:
+  auto add() -> uint32_t {
+    _parent.push_back(static_cast<uint32_t>(_parent.size()));
+    return _parent.back();
+  }
+
+  auto find(uint32_t i) -> uint32_t {
+    while (_parent[i] != i) {
+      _parent[i] = _parent[_parent[i]];
+      i = _parent[i];
+    }
+    return i;
+  }
+
+  auto unite(uint32_t a, uint32_t b) -> void {
+    a = find(a);
+    b = find(b);
+    if (a != b) {
+      _parent[std::max(a, b)] = std::min(a, b);
+    }
+  }
+
+  auto size() const -> size_t { return _parent.size(); }
+};
+
+auto ParallelReplay::run(std::vector<std::string> const & lines, std::ostream & out) -> void
+{
+  partition_(lines);
+
+  // The calling thread is worker 0: it gets its own CPUs back afterwards
+  auto caller_cpus = _options.cpus.empty() ? std::vector<int>() : allowedCpus();
+
+  // Partitions are balanced by line count, so workers simply take the next one
+  std::atomic<size_t> next{0};
+  auto worker = [&](size_t t) {
+    if (!_options.cpus.empty()) {
+      pinCurrentThread(_options.cpus[t % _options.cpus.size()]);
+    }
+    for (size_t p = next++; p < _partitions.size(); p = next++) {
+      match_(_partitions[p]);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < std::min(_nthreads, _partitions.size()); ++t) {
+    pool.emplace_back(worker, t);
+  }
+  worker(0);
+  for (auto & t : pool) {
+    t.join();
+  }
+  if (!caller_cpus.empty()) {
+    setAllowedCpus(caller_cpus);
+  }
+
+  merge_(out);
+}
+
+auto ParallelReplay::partition_(std::vector<std::string> const & lines) -> void
+{
+  _actions.clear();
+  _routes.clear();
+  _local.clear();
+  _partitions.clear();
+  _actions.reserve(lines.size());
+  _routes.reserve(lines.size());
+
+  std::unordered_map<Symbol, uint32_t> symbols;
+  std::unordered_map<OrderID, uint32_t> id_symbol;  // first symbol an id was placed on
+  std::vector<uint32_t> line_symbol(lines.size(), 0);
+  SymbolGroups groups;
+
+  for (uint32_t i = 0; i < lines.size(); ++i) {
+    try {
+      _actions.emplace_back(lines[i]);
+    }
+    catch (std::exception const & e) {
+      _actions.emplace_back("P");  // placeholder, never executed
+      _routes.push_back({RouteKind::Local, static_cast<uint32_t>(_local.size())});
+      _local.push_back(std::string(e.what()) + '\n');
+      continue;
+    }
+
+    auto const & action = _actions.back();
+    switch (action.type) {
+      case ActionType::Place : {
+        auto [it, inserted] = symbols.try_emplace(action.order.symbol, 0);
+        if (inserted) {
+          it->second = groups.add();
+        }
+        auto [first, fresh] = id_symbol.try_emplace(action.order.id, it->second);
+        if (!fresh) {
+          groups.unite(first->second, it->second);
+        }
+        line_symbol[i] = it->second;
+        _routes.push_back({RouteKind::Book, 0});
+        break;
+      }
+      case ActionType::Cancel : {
+        _routes.push_back({RouteKind::Book, 0});
+        break;
+      }
+      case ActionType::MassCancel :
+      case ActionType::Print :
+      case ActionType::Hash :
+      case ActionType::Stats :
+      case ActionType::Memory :
+      case ActionType::Delta : {
+        if (isBroadcast_(action)) {
+          _routes.push_back({RouteKind::Broadcast, 0});
+          break;
+        }
+        auto [it, inserted] = symbols.try_emplace(action.order.symbol, 0);
+        if (inserted) {
+          it->second = groups.add();
+        }
+        line_symbol[i] = it->second;
+        _routes.push_back({RouteKind::Book, 0});
+        break;
+      }
+    }
+  }
+
+  // X lines are resolved once every O has been seen: an X may precede the O
+  // it names, in which case it still has to run in that symbol's book
+  for (uint32_t i = 0; i < lines.size(); ++i) {
+    if (_routes[i].kind != RouteKind::Book || _actions[i].type != ActionType::Cancel) {
+      continue;
+    }
+    auto it = id_symbol.find(_actions[i].order.id);
+    if (it == id_symbol.end()) {
+      std::ostringstream os;
+      os << Result::Error(_actions[i].order.id, "Order does not exist") << '\n';
+      _routes[i] = {RouteKind::Local, static_cast<uint32_t>(_local.size())};
+      _local.push_back(os.str());
+    }
+    else {
+      line_symbol[i] = it->second;
+    }
+  }
+
+  // Count lines per group and pack groups into partitions, largest first,
+  // each into the currently lightest partition
+  std::vector<size_t> group_load(groups.size(), 0);
+  for (uint32_t i = 0; i < lines.size(); ++i) {
+    if (_routes[i].kind == RouteKind::Book) {
+      group_load[groups.find(line_symbol[i])]++;
+    }
+  }
+  std::vector<uint32_t> roots;
+  for (uint32_t g = 0; g < groups.size(); ++g) {
+    if (groups.find(g) == g) {
+      roots.push_back(g);
+    }
+  }
+  std::stable_sort(roots.begin(), roots.end(), [&](uint32_t a, uint32_t b) {
+    return group_load[a] > group_load[b];
+  });
+
+  auto npartitions = std::max<size_t>(std::min(roots.size(), 4 * _nthreads), 1);
+  _partitions.resize(npartitions);
+  using Load = std::pair<size_t, uint32_t>;
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> lightest;
+  for (uint32_t p = 0; p < npartitions; ++p) {
+    lightest.push({0, p});
+  }
+  std::vector<uint32_t> group_partition(groups.size(), 0);
+  for (auto g : roots) {
+    auto [load, p] = lightest.top();
+    lightest.pop();
+    group_partition[g] = p;
+    lightest.push({load + group_load[g], p});
+  }
+
+  for (uint32_t i = 0; i < lines.size(); ++i) {
+    if (_routes[i].kind == RouteKind::Book) {
+      auto p = group_partition[groups.find(line_symbol[i])];
+      _routes[i].target = p;
+      _partitions[p].lines.push_back(i);
+    }
+    else if (_routes[i].kind == RouteKind::Broadcast) {
+      for (auto & part : _partitions) {
+        part.lines.push_back(i);
+      }
+    }
+  }
+}
+
+auto ParallelReplay::match_(Partition & part) const -> void
+{
+  MultiSymbolBook book;
+  std::ostringstream os;
+  part.text_ends.reserve(part.lines.size());
+
+  for (auto i : part.lines) {
+    auto const & action = _actions[i];
+    try {
+      execute(book, action);
+      if (isBroadcast_(action)) {
+        auto const & results = book.getResults();
+        part.broadcast.insert(part.broadcast.end(), results.begin(), results.end());
+        part.broadcast_ends.push_back(part.broadcast.size());
+        continue;
+      }
+      for (auto const & r : book.getResults()) {
+        os << r << '\n';
+      }
+    }
+    catch (std::exception const & e) {
+      os << e.what() << '\n';
+    }
+    part.text_ends.push_back(static_cast<size_t>(os.tellp()));
+  }
+  part.text = std::move(os).str();
+}
+
+auto ParallelReplay::merge_(std::ostream & out) const -> void
+{
+  std::vector<size_t> text_pos(_partitions.size(), 0), text_line(_partitions.size(), 0);
+  std::vector<size_t> broadcast_pos(_partitions.size(), 0), broadcast_line(_partitions.size(), 0);
+  std::vector<Result> merged;
+
+  for (size_t i = 0; i < _routes.size(); ++i) {
+    auto const & route = _routes[i];
+    switch (route.kind) {
+      case RouteKind::Local : {
+        out << _local[route.target];
+        break;
+      }
+      case RouteKind::Book : {
+        auto p = route.target;
+        auto const & part = _partitions[p];
+        auto end = part.text_ends[text_line[p]++];
+        out.write(part.text.data() + text_pos[p], static_cast<std::streamsize>(end - text_pos[p]));
+        text_pos[p] = end;
+        break;
+      }
+      case RouteKind::Broadcast : {
+        merged.clear();
+        for (size_t p = 0; p < _partitions.size(); ++p) {
+          auto const & part = _partitions[p];
+          auto begin = part.broadcast.begin();
+          auto end = part.broadcast_ends[broadcast_line[p]++];
+          merged.insert(merged.end(), begin + broadcast_pos[p], begin + end);
+          broadcast_pos[p] = end;
+        }
+        if (_actions[i].type == ActionType::Hash) {
+          uint64_t hash = 0;
+          for (auto const & r : merged) {
+            hash += r.value;
+          }
+          merged = {Result::BookHash(Symbol(), hash)};
+        }
+        else if (_actions[i].type == ActionType::Memory) {
+          // Every partition lists the same categories in the same order
+          auto ncategories = merged.size() / _partitions.size();
+          for (size_t r = ncategories; r < merged.size(); ++r) {
+            merged[r % ncategories].value += merged[r].value;
+          }
+          merged.resize(ncategories);
+        }
+        sortBySymbol_(merged);
+        for (auto const & r : merged) {
+          out << r << '\n';
+        }
+        break;
+      }
+    }
+  }
+}
+
+auto ParallelReplay::isBroadcast_(Action const & action) -> bool
+{
+  return action.type == ActionType::Print ||
+      (action.type == ActionType::MassCancel && action.scope == CancelScope::Book) ||
+      (action.type == ActionType::Hash && action.order.symbol.view().empty()) ||
+      (action.type == ActionType::Memory && action.order.symbol.view().empty()) ||
+      (action.type == ActionType::Delta && action.order.symbol.view().empty());
+}
+
+auto ParallelReplay::sortBySymbol_(std::vector<Result> & results) -> void
+{
+  std::stable_sort(results.begin(), results.end(), [](Result const & a, Result const & b) {
+    return a.symbol.view() < b.symbol.view();
+  });
+}
+
+auto ParallelReplay::runSequential(std::vector<std::string> const & lines, std::ostream & out) -> void
+{
+  MultiSymbolBook book;
+  for (auto const & line : lines) {
+    try {
+      execute(book, Action(line), out);
+    }
+    catch (std::exception const & e) {
+      out << e.what() << '\n';
+    }
+  }
+}
+
+}  // end namespace hft
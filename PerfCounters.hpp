@@ -0,0 +1,158 @@
+#pragma once
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hft {
+
+/*
+** Hardware counters of the calling thread through perf_event_open(2).
+**
+** Every event is opened on its own rather than as a group, so that a PMU
+** lacking one event (or a VM exposing none) still reports the others; the
+** missing ones read as std::nullopt. Counts are scaled by time enabled /
+** time running in case the kernel multiplexes them. Only user space is
+** counted, which works with the default perf_event_paranoid of 2.
+*/
+class PerfCounters {
+ public:
+  enum Event {
+    Cycles,
+    Instructions,
+    L1DMisses,
+    LLCMisses,
+    BranchMisses,
+    DTLBMisses,
+    NumEvents,
+  };
+
+  using Counts = std::array<std::optional<double>, NumEvents>;
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(PerfCounters const &) = delete;
+  auto operator=(PerfCounters const &) -> PerfCounters & = delete;
+
+  auto available() const -> bool;
+  // Why the first unavailable event could not be opened
+  auto error() const -> std::string_view { return _error; }
+
+  // Counters accumulate between start and stop until reset
+  auto start() -> void;
+  auto stop() -> void;
+  auto reset() -> void;
+  auto read() const -> Counts;
+
+  static auto name(Event e) -> std::string_view;
+
+ private:
+  std::array<int, NumEvents> _fds;
+  std::string _error;
+
+  static auto open_(uint32_t type, uint64_t config) -> int;
+  auto ioctlAll_(unsigned long request) -> void;
+};
+
+PerfCounters::PerfCounters()
+{
+  auto cache = [](uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+  };
+  std::array<std::pair<uint32_t, uint64_t>, NumEvents> events{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  }};
+  for (size_t i = 0; i < NumEvents; ++i) {
+    _fds[i] = open_(events[i].first, events[i].second);
+    if (_fds[i] < 0 && _error.empty()) {
+      _error = std::string(name(static_cast<Event>(i))) + ": " + std::strerror(errno);
+    }
+  }
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (auto fd : _fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+auto PerfCounters::open_(uint32_t type, uint64_t config) -> int
+{
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+auto PerfCounters::available() const -> bool
+{
+  for (auto fd : _fds) {
+    if (fd >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto PerfCounters::ioctlAll_(unsigned long request) -> void
+{
+  for (auto fd : _fds) {
+    if (fd >= 0) {
+      ioctl(fd, request, 0);
+    }
+  }
+}
+
+auto PerfCounters::start() -> void { ioctlAll_(PERF_EVENT_IOC_ENABLE); }
+auto PerfCounters::stop() -> void { ioctlAll_(PERF_EVENT_IOC_DISABLE); }
+auto PerfCounters::reset() -> void { ioctlAll_(PERF_EVENT_IOC_RESET); }
+
+auto PerfCounters::read() const -> Counts
+{
+  Counts counts;
+  for (size_t i = 0; i < NumEvents; ++i) {
+    uint64_t value[3];  // count, time enabled, time running
+    if (_fds[i] < 0 || ::read(_fds[i], value, sizeof(value)) != sizeof(value)) {
+      continue;
+    }
+    counts[i] = value[2] ? static_cast<double>(value[0]) * static_cast<double>(value[1]) / static_cast<double>(value[2]) : 0.;
+  }
+  return counts;
+}
+
+auto PerfCounters::name(Event e) -> std::string_view
+{
+  switch (e) {
+    case Cycles: return "cycles";
+    case Instructions: return "instructions";
+    case L1DMisses: return "L1d-misses";
+    case LLCMisses: return "LLC-misses";
+    case BranchMisses: return "branch-misses";
+    case DTLBMisses: return "dTLB-misses";
+    case NumEvents: break;
+  }
+  return "";
+}
+
+}  // end namespace hft
@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <string>
 #include <iomanip>
+#include "FieldDecode.hpp"
 
 // (7.5 format means up to 7 digits before the decimal
 // and exactly 5 digits after the decimal)
@@ -12,6 +13,7 @@ class Price {
 
   constexpr static int32_t MAX_INTEGRAL = 100'000'000;  // 10^8
   constexpr static int32_t MAX_DECIMAL = 1'000'000;        // 10^6
+  constexpr static int32_t TICKS_PER_UNIT = 100'000;      // 5 decimals
  public:
   Price() : _val(0) {}
 
@@ -22,6 +24,21 @@ class Price {
 
   static auto fromString(std::string_view s, Price &p) -> bool;
 
+  // Encoded value, for hashing
+  auto raw() const -> int64_t { return _val; }
+
+  // The price in units of 0.00001, which unlike the encoded value is linear
+  auto ticks() const -> int64_t {
+    return _val / MAX_DECIMAL * TICKS_PER_UNIT + _val % MAX_DECIMAL;
+  }
+
+  static auto fromTicks(int64_t ticks) -> Price {
+    return Price(ticks / TICKS_PER_UNIT * MAX_DECIMAL + ticks % TICKS_PER_UNIT);
+  }
+
+  // Highest representable price
+  static auto max() -> Price { return Price(int64_t{MAX_INTEGRAL - 1} * MAX_DECIMAL + MAX_DECIMAL / 10 - 1); }
+
   explicit Price(std::string_view s) {
     if (!Price::fromString(s, *this)) {
       throw std::invalid_argument("Invalid price format");
@@ -89,32 +106,15 @@ std::istream& operator>>(std::istream& os, Price& price) {
 }
 
 bool Price::fromString(std::string_view s, Price & p) {
-  auto dot = s.find('.');
-  if (dot == std::string_view::npos) {
-    return false;
-  }
-  if (dot > 7) {
-    return false;
-  }
-  if (s.size() - dot - 1 != 5) {
-    return false;
+  int64_t val;
+  switch (hft::decodePrice(s, val)) {
+    case hft::DecodeStatus::Ok:
+      p._val = val;
+      return true;
+    case hft::DecodeStatus::BadFormat:
+      return false;
+    case hft::DecodeStatus::BadDigit:
+      break;
   }
-
-  auto integral = std::stoll(std::string(s.substr(0, dot)));
-  auto decimal = std::stoll(std::string(s.substr(dot + 1)));
-
-  if (integral < 0 || decimal < 0) {
-    return false;
-  }
-
-  if (decimal >= Price::MAX_DECIMAL) {
-    return false;
-  }
-
-  if (integral >= Price::MAX_INTEGRAL) {
-    return false;
-  }
-
-  p._val = integral * Price::MAX_DECIMAL + decimal;
-  return true;
+  throw std::invalid_argument("Invalid price digits");
 }
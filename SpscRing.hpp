@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hft {
+
+/*
+** Bounded single-producer single-consumer queue.
+**
+** The producer owns _tail and the consumer _head, each on its own cache line;
+** each side also keeps a stale copy of the other's index and only reloads it
+** when the ring looks full (or empty), so an uncontended push or pop touches
+** no cache line the other thread writes.
+*/
+template <typename T>
+class SpscRing {
+  static constexpr size_t CACHE_LINE = 64;
+
+  std::vector<T> _slots;
+  size_t _mask;
+  alignas(CACHE_LINE) std::atomic<uint64_t> _head{0};  // next slot to pop
+  uint64_t _cached_tail{0};                           // consumer's view of _tail
+  alignas(CACHE_LINE) std::atomic<uint64_t> _tail{0};  // next slot to push
+  uint64_t _cached_head{0};                           // producer's view of _head
+
+ public:
+  // capacity is rounded up to a power of two
+  explicit SpscRing(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    _slots.resize(size);
+    _mask = size - 1;
+  }
+
+  // Producer only; false if the ring is full
+  auto tryPush(T const & value) -> bool
+  {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _cached_head == _slots.size()) {
+      _cached_head = _head.load(std::memory_order_acquire);
+      if (tail - _cached_head == _slots.size()) {
+        return false;
+      }
+    }
+    _slots[tail & _mask] = value;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only; false if the ring is empty
+  auto tryPop(T & value) -> bool
+  {
+    auto head = _head.load(std::memory_order_relaxed);
+    if (head == _cached_tail) {
+      _cached_tail = _tail.load(std::memory_order_acquire);
+      if (head == _cached_tail) {
+        return false;
+      }
+    }
+    value = _slots[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  auto empty() const -> bool
+  {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+  auto capacity() const -> size_t { return _slots.size(); }
+};
+
+}  // end namespace hft
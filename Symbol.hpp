@@ -24,14 +24,15 @@ class Symbol {
     return *this;
   }
 
-  Symbol(const char* str) {
+  Symbol(const char* str) : Symbol(std::string_view(str)) {}
+
+  explicit Symbol(std::string_view view) {
     std::fill(_data.begin(), _data.end(), 0);
-    auto view = std::string_view(str);
     if (view.size() > 8) {
       throw std::runtime_error("Symbol too long");
     }
     std::copy(view.begin(), view.end(), _data.begin());
-    _view = std::string_view(_data.data());
+    _view = std::string_view(_data.data(), view.size());
   }
 
   auto operator==(const char* str) -> bool {
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+** Thread placement and waiting for the threads that run books.
+**
+** A pinned thread is bound to one CPU with sched_setaffinity(2), so the
+** scheduler never migrates it away from its warm caches and TLB. Spin waits
+** poll instead of sleeping in the kernel, trading a core for wake-up latency;
+** they only pay off when every spinning thread has a CPU of its own.
+*/
+namespace hft {
+
+enum class WaitPolicy { Block, Spin };
+
+std::ostream& operator<<(std::ostream& os, WaitPolicy policy) {
+  switch (policy) {
+    case WaitPolicy::Block: os << "Block"; break;
+    case WaitPolicy::Spin: os << "Spin"; break;
+  }
+  return os;
+}
+
+// Where the threads of a pool run
+struct ThreadOptions
+{
+  std::vector<int> cpus;  // thread i is pinned to cpus[i % size], none if empty
+};
+
+// Lets the calling thread run on cpus only; false if none of them is usable
+auto setAllowedCpus(std::vector<int> const & cpus) -> bool
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Binds the calling thread to cpu
+auto pinCurrentThread(int cpu) -> bool
+{
+  return setAllowedCpus({cpu});
+}
+
+// CPUs the calling thread may run on
+auto allowedCpus() -> std::vector<int>
+{
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+// "0,2-4" -> {0, 2, 3, 4}; throws std::invalid_argument on anything else
+auto parseCpuList(std::string_view s) -> std::vector<int>
+{
+  auto number = [](std::string_view digits) {
+    int cpu = 0;
+    auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), cpu);
+    if (digits.empty() || error != std::errc() || end != digits.data() + digits.size()) {
+      throw std::invalid_argument("Invalid CPU list");
+    }
+    return cpu;
+  };
+  std::vector<int> cpus;
+  while (!s.empty()) {
+    auto item = s.substr(0, s.find(','));
+    s.remove_prefix(std::min(item.size() + 1, s.size()));
+    auto dash = item.find('-');
+    auto first = number(item.substr(0, dash));
+    auto last = dash == std::string_view::npos ? first : number(item.substr(dash + 1));
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      throw std::invalid_argument("Invalid CPU list");
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Spin-loop hint, lets the sibling hyperthread run
+auto cpuRelax() -> void
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+// Returns once word no longer holds old. Blocking waits need a notify_one or
+// notify_all on word after it changes
+template <typename T>
+auto waitWhileEqual(std::atomic<T> const & word, T old, WaitPolicy policy) -> void
+{
+  if (policy == WaitPolicy::Spin) {
+    while (word.load(std::memory_order_acquire) == old) {
+      cpuRelax();
+    }
+  }
+  else {
+    word.wait(old, std::memory_order_acquire);
+  }
+}
+
+}  // end namespace hft
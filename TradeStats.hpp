@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Price.hpp"
+
+/*
+** Running trade statistics of a symbol, updated in O(1) per fill.
+**
+** A trade is one fill of a resting order (the incoming order's confirmation
+** reports the same trade again and is not counted). Prices are accumulated in
+** ticks of 0.00001, so the traded notional is exact: a 128-bit sum of
+** ticks * quantity cannot overflow. Only the VWAP is rounded, to the nearest
+** tick when it is read.
+**
+** Besides the session totals, trades can be bucketed into sequence bars of a
+** fixed number of trades, of which the last few are kept in a ring buffer.
+** Actions carry no timestamps, so there are no time bars.
+*/
+namespace hft {
+
+__extension__ typedef __int128 Notional;
+
+struct TradeBar
+{
+  Price open;
+  Price high;
+  Price low;
+  Price close;
+  uint64_t volume{0};
+  uint64_t trades{0};
+  Notional notional{0};  // sum of price ticks * quantity
+
+  auto add(Price price, uint32_t quantity) -> void;
+  // Volume-weighted average price, rounded half up to a tick. Needs a trade
+  auto vwap() const -> Price;
+};
+
+auto TradeBar::add(Price price, uint32_t quantity) -> void
+{
+  if (!trades) {
+    open = high = low = price;
+  }
+  high = std::max(high, price);
+  low = std::min(low, price);
+  close = price;
+  volume += quantity;
+  trades++;
+  notional += static_cast<Notional>(price.ticks()) * quantity;
+}
+
+auto TradeBar::vwap() const -> Price
+{
+  auto const v = static_cast<Notional>(volume);
+  return Price::fromTicks(static_cast<int64_t>((notional + v / 2) / v));
+}
+
+// VOLUME TRADES [OPEN HIGH LOW CLOSE VWAP], the prices only once there was a trade
+std::ostream& operator<<(std::ostream& os, TradeBar const & bar) {
+  os << bar.volume << " " << bar.trades;
+  if (bar.trades) {
+    os << " " << bar.open << " " << bar.high << " " << bar.low << " " << bar.close << " " << bar.vwap();
+  }
+  return os;
+}
+
+class TradeStats {
+  TradeBar _session;
+  uint64_t _trades_per_bar{0};  // 0 when bars are off
+  std::vector<TradeBar> _bars;  // ring, bar i is at i % size
+  uint64_t _nbars{0};           // bars started so far
+
+ public:
+  // Starts bucketing trades into bars of trades_per_bar trades, keeping the
+  // last nbars of them; either being 0 turns bars off. Drops existing bars
+  auto configureBars(uint64_t trades_per_bar, size_t nbars) -> void;
+  auto add(Price price, uint32_t quantity) -> void;
+
+  auto session() const -> TradeBar const & { return _session; }
+  // Bars still held are [firstBar(), endBar()), the last one possibly unfinished
+  auto firstBar() const -> uint64_t { return _nbars - std::min<uint64_t>(_nbars, _bars.size()); }
+  auto endBar() const -> uint64_t { return _nbars; }
+  auto bar(uint64_t i) const -> TradeBar const & { return _bars[i % _bars.size()]; }
+  // Heap memory of the bar ring
+  auto barBytes() const -> size_t { return _bars.capacity() * sizeof(TradeBar); }
+};
+
+auto TradeStats::configureBars(uint64_t trades_per_bar, size_t nbars) -> void
+{
+  _trades_per_bar = nbars ? trades_per_bar : 0;
+  _bars.assign(_trades_per_bar ? nbars : 0, TradeBar());
+  _nbars = 0;
+}
+
+auto TradeStats::add(Price price, uint32_t quantity) -> void
+{
+  if (_trades_per_bar) {
+    // Bars count the trades since they were configured
+    if (!_nbars || bar(_nbars - 1).trades == _trades_per_bar) {
+      _bars[_nbars++ % _bars.size()] = TradeBar();
+    }
+    _bars[(_nbars - 1) % _bars.size()].add(price, quantity);
+  }
+  _session.add(price, quantity);
+}
+
+}  // end namespace hft
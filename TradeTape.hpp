@@ -0,0 +1,447 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "basic_types.hpp"
+#include "SpscRing.hpp"
+#include "ThreadTuning.hpp"
+
+/*
+** Binary archive of every trade, written off the matching thread.
+**
+** The matcher hands each fill of a resting order to TradeTape::record, which
+** numbers it and pushes it onto an SpscRing, and the book calls publish once
+** the action is done, so that waking the writer costs one fence per action
+** rather than one per fill. The writer thread drains the ring
+** into per-symbol blocks and appends each block to the file once it holds
+** block_rows trades (the rest when the tape is closed). A block is a header
+** followed by one column per field:
+**
+**   header  "TTB1", symbol (8 bytes, zero padded), rows (u32),
+**           first and last sequence number (u64), byte length of each column (5 x u32)
+**   seq     delta from the previous row, varint
+**   maker   resting order id, zigzag delta, varint
+**   taker   incoming order id, zigzag delta, varint
+**   qty     varint
+**   price   ticks of 0.00001, zigzag delta, varint
+**
+** The first row of a column is a delta from 0. Integers in the header are in
+** host byte order. TapeReader skips blocks of other symbols or outside the
+** sequence range from their header alone, and reads only the columns asked for.
+*/
+namespace hft {
+
+enum class TapeColumn : uint8_t { Seq, Maker, Taker, Quantity, Price };
+
+std::ostream& operator<<(std::ostream& os, TapeColumn column) {
+  switch (column) {
+    case TapeColumn::Seq: os << "seq"; break;
+    case TapeColumn::Maker: os << "maker"; break;
+    case TapeColumn::Taker: os << "taker"; break;
+    case TapeColumn::Quantity: os << "qty"; break;
+    case TapeColumn::Price: os << "price"; break;
+  }
+  return os;
+}
+
+constexpr size_t TAPE_COLUMNS = 5;
+// Bit set of TapeColumns
+using TapeColumns = uint8_t;
+constexpr TapeColumns ALL_TAPE_COLUMNS = (1 << TAPE_COLUMNS) - 1;
+
+constexpr auto tapeColumn(TapeColumn column) -> TapeColumns { return 1 << static_cast<int>(column); }
+
+// "seq,qty" -> the bit set of those columns
+auto parseTapeColumns(std::string_view s) -> TapeColumns
+{
+  TapeColumns columns = 0;
+  while (!s.empty()) {
+    auto name = s.substr(0, s.find(','));
+    s.remove_prefix(std::min(name.size() + 1, s.size()));
+    size_t c = 0;
+    for (; c < TAPE_COLUMNS; ++c) {
+      std::ostringstream os;
+      os << static_cast<TapeColumn>(c);
+      if (os.view() == name) {
+        break;
+      }
+    }
+    if (c == TAPE_COLUMNS) {
+      throw std::invalid_argument("Unknown tape column");
+    }
+    columns |= tapeColumn(static_cast<TapeColumn>(c));
+  }
+  return columns;
+}
+
+struct Trade
+{
+  uint64_t seq{0};  // 1 for the first trade of the tape
+  Symbol symbol;
+  OrderID maker{0};
+  OrderID taker{0};
+  Quantity quantity{0};
+  Price price;
+};
+
+namespace tape {
+
+constexpr std::array<char, 4> MAGIC{'T', 'T', 'B', '1'};
+
+struct BlockHeader
+{
+  std::array<char, 4> magic;
+  std::array<char, 8> symbol;
+  uint32_t rows;
+  uint64_t first_seq;
+  uint64_t last_seq;
+  std::array<uint32_t, TAPE_COLUMNS> column_bytes;
+};
+
+auto zigzag(int64_t n) -> uint64_t { return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63); }
+auto unzigzag(uint64_t n) -> int64_t { return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1); }
+
+auto putVarint(std::string & out, uint64_t n) -> void
+{
+  while (n >= 0x80) {
+    out.push_back(static_cast<char>(n | 0x80));
+    n >>= 7;
+  }
+  out.push_back(static_cast<char>(n));
+}
+
+auto getVarint(char const *& p, char const * end) -> uint64_t
+{
+  uint64_t n = 0;
+  for (int shift = 0; p != end && shift < 64; shift += 7) {
+    auto byte = static_cast<uint8_t>(*p++);
+    n |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return n;
+    }
+  }
+  throw std::runtime_error("Corrupt trade tape");
+}
+
+// How the values of a column become varints
+enum class Coding { Plain, Delta, ZigzagDelta };
+
+constexpr std::array<Coding, TAPE_COLUMNS> CODINGS{Coding::Delta, Coding::ZigzagDelta, Coding::ZigzagDelta,
+                                                   Coding::Plain, Coding::ZigzagDelta};
+
+auto fieldOf(Trade const & trade, TapeColumn column) -> int64_t
+{
+  switch (column) {
+    case TapeColumn::Seq: return static_cast<int64_t>(trade.seq);
+    case TapeColumn::Maker: return trade.maker;
+    case TapeColumn::Taker: return trade.taker;
+    case TapeColumn::Quantity: return trade.quantity;
+    case TapeColumn::Price: return trade.price.ticks();
+  }
+  return 0;
+}
+
+auto setField(Trade & trade, TapeColumn column, int64_t value) -> void
+{
+  switch (column) {
+    case TapeColumn::Seq: trade.seq = static_cast<uint64_t>(value); break;
+    case TapeColumn::Maker: trade.maker = static_cast<OrderID>(value); break;
+    case TapeColumn::Taker: trade.taker = static_cast<OrderID>(value); break;
+    case TapeColumn::Quantity: trade.quantity = static_cast<Quantity>(value); break;
+    case TapeColumn::Price: trade.price = Price::fromTicks(value); break;
+  }
+}
+
+auto encodeColumn(std::vector<Trade> const & rows, TapeColumn column, std::string & out) -> void
+{
+  auto coding = CODINGS[static_cast<size_t>(column)];
+  out.clear();
+  int64_t prev = 0;
+  for (auto const & trade : rows) {
+    auto value = fieldOf(trade, column);
+    auto delta = coding == Coding::Plain ? value : value - prev;
+    putVarint(out, coding == Coding::ZigzagDelta ? zigzag(delta) : static_cast<uint64_t>(delta));
+    prev = value;
+  }
+}
+
+auto decodeColumn(std::string const & in, TapeColumn column, std::vector<Trade> & rows) -> void
+{
+  auto coding = CODINGS[static_cast<size_t>(column)];
+  auto p = in.data();
+  auto end = p + in.size();
+  int64_t prev = 0;
+  for (auto & trade : rows) {
+    auto n = getVarint(p, end);
+    auto delta = coding == Coding::ZigzagDelta ? unzigzag(n) : static_cast<int64_t>(n);
+    prev = coding == Coding::Plain ? delta : prev + delta;
+    setField(trade, column, prev);
+  }
+}
+
+}  // end namespace tape
+
+class TradeTape {
+  std::ofstream _file;
+  size_t _block_rows;
+  WaitPolicy _wait;
+  SpscRing<Trade> _ring;
+  uint64_t _next_seq{0};   // matching thread only
+  uint64_t _stalls{0};     // pushes that found the ring full
+  bool _unpublished{false};  // matching thread only: trades recorded since the last publish
+  std::atomic<bool> _stopping{false};
+  std::atomic<bool> _sleeping{false};  // the writer is about to block on _signal
+  std::atomic<uint32_t> _signal{0};
+  std::unordered_map<Symbol, std::vector<Trade>> _open;  // writer thread only
+  std::array<std::string, TAPE_COLUMNS> _columns;  // encoding buffers of the writer
+  std::thread _writer;
+
+ public:
+  // Creates (or truncates) path. Trades are written in blocks of block_rows per symbol;
+  // ring_size bounds how far the writer may fall behind before record waits
+  explicit TradeTape(std::string const & path, size_t block_rows = 4096, size_t ring_size = 1 << 16,
+                     WaitPolicy wait = WaitPolicy::Block);
+  // Writes out the trades still held and joins the writer
+  ~TradeTape();
+  TradeTape(TradeTape const &) = delete;
+  auto operator=(TradeTape const &) -> TradeTape & = delete;
+
+  // Called by the matching thread for every fill of a resting order
+  auto record(Symbol const & symbol, OrderID maker, OrderID taker, Quantity quantity, Price price) -> void;
+  // Called by the matching thread after the fills of an action: wakes the
+  // writer if it is asleep. Trades recorded and not published yet are only
+  // written once the ring fills up or the tape is closed
+  auto publish() -> void;
+  auto trades() const -> uint64_t { return _next_seq; }
+  auto stalls() const -> uint64_t { return _stalls; }
+
+ private:
+  auto run_() -> void;
+  auto append_(Trade const & trade) -> void;
+  auto writeBlock_(Symbol const & symbol, std::vector<Trade> & rows) -> void;
+};
+
+TradeTape::TradeTape(std::string const & path, size_t block_rows, size_t ring_size, WaitPolicy wait)
+    : _file(path, std::ios::binary | std::ios::trunc),
+      _block_rows(std::max<size_t>(block_rows, 1)),
+      _wait(wait),
+      _ring(ring_size)
+{
+  if (!_file) {
+    throw std::runtime_error("Cannot open trade tape " + path);
+  }
+  _writer = std::thread([this] { run_(); });
+}
+
+TradeTape::~TradeTape()
+{
+  _stopping.store(true);
+  _signal.fetch_add(1);
+  _signal.notify_one();
+  _writer.join();
+}
+
+auto TradeTape::record(Symbol const & symbol, OrderID maker, OrderID taker, Quantity quantity, Price price) -> void
+{
+  Trade trade{++_next_seq, symbol, maker, taker, quantity, price};
+  _unpublished = true;
+  if (!_ring.tryPush(trade)) {
+    // The writer has fallen behind, or sleeps on a ring filled without a
+    // publish; wake it and give it the CPU if it shares ours
+    ++_stalls;
+    publish();
+    _unpublished = true;
+    for (int spins = 0; !_ring.tryPush(trade); ++spins) {
+      if (spins < 64) {
+        cpuRelax();
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+auto TradeTape::publish() -> void
+{
+  if (!_unpublished) {
+    return;
+  }
+  _unpublished = false;
+  if (_wait == WaitPolicy::Block) {
+    // Pairs with the fence in run_: either the writer sees the trades or we see it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load(std::memory_order_relaxed)) {
+      _signal.fetch_add(1, std::memory_order_release);
+      _signal.notify_one();
+    }
+  }
+}
+
+auto TradeTape::run_() -> void
+{
+  Trade trade;
+  for (;;) {
+    if (_ring.tryPop(trade)) {
+      append_(trade);
+      continue;
+    }
+    if (_stopping.load()) {
+      // record is not called any more, so whatever the ring holds now is the rest
+      while (_ring.tryPop(trade)) {
+        append_(trade);
+      }
+      break;
+    }
+    if (_wait == WaitPolicy::Spin) {
+      cpuRelax();
+      continue;
+    }
+    auto signal = _signal.load(std::memory_order_acquire);
+    _sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_ring.empty() && !_stopping.load()) {
+      _signal.wait(signal, std::memory_order_acquire);
+    }
+    _sleeping.store(false, std::memory_order_relaxed);
+  }
+
+  // Partial blocks in symbol order, so that a replay writes the same file twice
+  std::vector<Symbol> symbols;
+  for (auto const & [symbol, rows] : _open) {
+    if (!rows.empty()) {
+      symbols.push_back(symbol);
+    }
+  }
+  std::sort(symbols.begin(), symbols.end(), [](Symbol const & a, Symbol const & b) { return a.view() < b.view(); });
+  for (auto const & symbol : symbols) {
+    writeBlock_(symbol, _open[symbol]);
+  }
+  _file.flush();
+}
+
+auto TradeTape::append_(Trade const & trade) -> void
+{
+  auto & rows = _open[trade.symbol];
+  if (rows.capacity() < _block_rows) {
+    rows.reserve(_block_rows);
+  }
+  rows.push_back(trade);
+  if (rows.size() == _block_rows) {
+    writeBlock_(trade.symbol, rows);
+  }
+}
+
+auto TradeTape::writeBlock_(Symbol const & symbol, std::vector<Trade> & rows) -> void
+{
+  for (size_t c = 0; c < TAPE_COLUMNS; ++c) {
+    tape::encodeColumn(rows, static_cast<TapeColumn>(c), _columns[c]);
+  }
+
+  // Zeroed as a whole so that its padding bytes are the same in every file
+  tape::BlockHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = tape::MAGIC;
+  std::copy(symbol.view().begin(), symbol.view().end(), header.symbol.begin());
+  header.rows = static_cast<uint32_t>(rows.size());
+  header.first_seq = rows.front().seq;
+  header.last_seq = rows.back().seq;
+  for (size_t c = 0; c < TAPE_COLUMNS; ++c) {
+    header.column_bytes[c] = static_cast<uint32_t>(_columns[c].size());
+  }
+  _file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  for (auto const & column : _columns) {
+    _file.write(column.data(), static_cast<std::streamsize>(column.size()));
+  }
+  rows.clear();
+}
+
+class TapeReader {
+  std::ifstream _file;
+
+ public:
+  explicit TapeReader(std::string const & path);
+
+  // Calls visit(Trade const &) for each trade of symbol with from <= seq <= to,
+  // in sequence order. Only the fields of columns are filled in (and symbol).
+  // Returns the number of blocks whose columns were read
+  template <typename Visit>
+  auto scan(Symbol const & symbol, uint64_t from, uint64_t to, TapeColumns columns, Visit visit) -> size_t;
+};
+
+TapeReader::TapeReader(std::string const & path) : _file(path, std::ios::binary)
+{
+  if (!_file) {
+    throw std::runtime_error("Cannot open trade tape " + path);
+  }
+}
+
+template <typename Visit>
+auto TapeReader::scan(Symbol const & symbol, uint64_t from, uint64_t to, TapeColumns columns, Visit visit) -> size_t
+{
+  std::array<char, 8> key{};
+  std::copy(symbol.view().begin(), symbol.view().end(), key.begin());
+  _file.clear();
+  _file.seekg(0);
+
+  size_t blocks_read = 0;
+  tape::BlockHeader header;
+  std::vector<Trade> rows;
+  std::string column;
+  while (_file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    if (header.magic != tape::MAGIC) {
+      throw std::runtime_error("Corrupt trade tape");
+    }
+    std::streamoff offset = 0;  // of the next column from the current position
+    auto skip_all = [&] {
+      for (auto bytes : header.column_bytes) {
+        offset += bytes;
+      }
+      _file.seekg(offset, std::ios::cur);
+    };
+    if (header.symbol != key || header.last_seq < from || header.first_seq > to) {
+      skip_all();
+      continue;
+    }
+
+    // The seq column is also needed to trim a block that is only partly in range
+    bool whole = from <= header.first_seq && header.last_seq <= to;
+    auto needed = columns | (whole ? 0 : tapeColumn(TapeColumn::Seq));
+    rows.assign(header.rows, Trade{0, symbol, 0, 0, 0, Price()});
+    for (size_t c = 0; c < TAPE_COLUMNS; ++c) {
+      if (!(needed & tapeColumn(static_cast<TapeColumn>(c)))) {
+        offset += header.column_bytes[c];
+        continue;
+      }
+      _file.seekg(offset, std::ios::cur);
+      offset = 0;
+      column.resize(header.column_bytes[c]);
+      if (!_file.read(column.data(), static_cast<std::streamsize>(column.size()))) {
+        throw std::runtime_error("Corrupt trade tape");
+      }
+      tape::decodeColumn(column, static_cast<TapeColumn>(c), rows);
+    }
+    _file.seekg(offset, std::ios::cur);
+    ++blocks_read;
+
+    for (auto const & trade : rows) {
+      if (whole || (from <= trade.seq && trade.seq <= to)) {
+        visit(trade);
+      }
+    }
+  }
+  return blocks_read;
+}
+
+}  // end namespace hft
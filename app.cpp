@@ -1,77 +1,130 @@
 #include <string>
 #include <fstream>
 #include <iostream>
-#include <list>
+#include <vector>
 #include <filesystem>
+#include <memory>
+#include <cstring>
 #include "MultiSymbolBook.hpp"
 #include "Action.hpp"
-
-using results_t = std::list<std::string>;
+#include "ActionBatch.hpp"
+#include "PacedReplay.hpp"
 
 class App
 {
+  std::unique_ptr<hft::TradeTape> _tape;  // outlives _book's use of it
   hft::MultiSymbolBook _book;
 public:
-    results_t action(const std::string& line) {
+    // Records every trade in a trade tape at tape_path, if one is given
+    explicit App(std::string const & tape_path = {}) {
+      if (!tape_path.empty()) {
+        _tape = std::make_unique<hft::TradeTape>(tape_path);
+        _book.setTradeTape(_tape.get());
+      }
+    }
+
+    void action(const std::string& line, std::ostream & out) {
       try {
-        hft::Action a(line);
-        switch (a.type) {
-          case hft::ActionType::Place : {
-            _book.add(a.order);
-            break;
-          }
-         case hft::ActionType::Cancel : {
-            _book.cancel(a.order.id);
-            break;
-          }
-          case hft::ActionType::Print : {
-            _book.print();
-            break;
-          }
-            default:
-              return results_t{"Unknown action type"};
-        }
-        return toString(_book.getResults());
+        hft::execute(_book, hft::Action(line), out);
       }
       catch (std::exception const & e) {
-        return results_t{e.what()};
+        out << e.what() << '\n';
+      }
+    }
+
+    // Runs lines in batches of batch_size (see ActionBatch.hpp) with the same
+    // output as action() on each line in turn. A P, or a line that does not
+    // decode, ends the batch before it
+    void actions(std::vector<std::string> const & lines, size_t batch_size, std::ostream & out) {
+      std::vector<hft::Action> batch;
+      auto run = [&] {
+        hft::runBatch(_book, batch, batch_size, [&](size_t, std::vector<hft::Result> const & results) {
+          write(results, out);
+        });
+        batch.clear();
+      };
+      for (auto const & line : lines) {
+        try {
+          batch.emplace_back(line);
+        }
+        catch (std::exception const & e) {
+          run();
+          out << e.what() << '\n';
+          continue;
+        }
+        if (batch.back().type == hft::ActionType::Print) {
+          auto print = std::move(batch.back());
+          batch.pop_back();
+          run();
+          hft::execute(_book, print, out);
+        }
       }
+      run();
     }
  private:
-  results_t toString(std::vector<hft::Result> const & results) {
-    results_t res;
+  void write(std::vector<hft::Result> const & results, std::ostream & out) {
     for (auto const & r : results) {
-      std::ostringstream os;
-      os << r;
-      res.push_back(os.str());
+      out << r << '\n';
     }
-    return res;
   }
 };
 
 
 auto main(int argc, char *argv[]) -> int
 {
+  // usage: app [--tape TAPE] [--batch N] [--capture CAPTURE] [FILE]
+  // --capture writes each line stamped with its arrival time (see PacedReplay.hpp)
   std::string file_name{"actions.txt"};
-  if (argc > 1) {
-    file_name = argv[1];
+  std::string tape_path;
+  std::unique_ptr<hft::SessionCapture> capture;
+  size_t batch_size = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--tape") && i + 1 < argc) {
+      tape_path = argv[++i];
+    }
+    else if (!std::strcmp(argv[i], "--batch") && i + 1 < argc) {
+      batch_size = std::stoul(argv[++i]);
+    }
+    else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc) {
+      capture = std::make_unique<hft::SessionCapture>(argv[++i]);
+    }
+    else {
+      file_name = argv[i];
+    }
   }
   if (!std::filesystem::exists(file_name)) {
     std::cerr << "File '" << file_name << "'" << " does not exist" << std::endl;
   }
 
-  App app;
+  App app(tape_path);
   std::string line;
   std::ifstream actions(file_name, std::ios::in);
+  if (batch_size > 1) {
+    std::vector<std::string> lines;
+    auto flush = [&] {
+      app.actions(lines, batch_size, std::cout);
+      lines.clear();
+    };
+    while (std::getline(actions, line)) {
+      if (line.empty()) continue;
+      if (capture) {
+        capture->record(line, hft::SessionCapture::now());
+      }
+      lines.push_back(std::move(line));
+      if (lines.size() == batch_size) {
+        flush();
+      }
+    }
+    flush();
+    return EXIT_SUCCESS;
+  }
   while (std::getline(actions, line)) {
     if (line.empty()) continue;
-
-    // std::cout << "entry " << line << std::endl;
-    results_t results = app.action(line);
-    // std::cout << "\t\t\tresults.size() = " << results.size() << std::endl;
-    for (results_t::const_iterator it = results.begin(); it != results.end(); ++it) {
-      std::cout << *it << std::endl;
+    if (capture) {
+      capture->record(line, hft::SessionCapture::now());
     }
+
+    app.action(line, std::cout);
   }
   return EXIT_SUCCESS;
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include <array>
+#include <cstdio>
 #include "memory"
 #include "Price.hpp"
 #include "Symbol.hpp"
+#include "TradeStats.hpp"
 
 namespace hft {
 
@@ -16,13 +18,50 @@ std::ostream& operator<<(std::ostream& os, const Side& s) {
   return os;
 }
 
+/*
+** Stop and StopLimit orders wait off the book until a trade of their symbol
+** reaches stop_price (at or above it for a buy, at or below for a sell). Then
+** a Stop becomes a Market order and a StopLimit a Limit order at price.
+*/
+enum class OrderType : char { Limit, Market, Stop, StopLimit };
+
+std::ostream& operator<<(std::ostream& os, OrderType type) {
+  switch (type) {
+    case OrderType::Limit: os << "Limit"; break;
+    case OrderType::Market: os << "Market"; break;
+    case OrderType::Stop: os << "Stop"; break;
+    case OrderType::StopLimit: os << "StopLimit"; break;
+  }
+  return os;
+}
+
+/*
+** How long a limit order may rest. GTC rests until filled or cancelled; IOC
+** fills what it can at once and cancels the rest; FOK fills completely at once
+** or is cancelled without trading.
+*/
+enum class TimeInForce : char { GTC, IOC, FOK };
+
+std::ostream& operator<<(std::ostream& os, TimeInForce tif) {
+  switch (tif) {
+    case TimeInForce::GTC: os << "GTC"; break;
+    case TimeInForce::IOC: os << "IOC"; break;
+    case TimeInForce::FOK: os << "FOK"; break;
+  }
+  return os;
+}
+
 struct Order
 {
   OrderID id;
   Symbol symbol;
   Side side;
-  Quantity quantity;
+  Quantity quantity;  // open quantity until the order rests, then kept by its level
   Price price;
+  uint64_t seq{0};  // time priority within the symbol, set when the order rests
+  OrderType type{OrderType::Limit};
+  TimeInForce tif{TimeInForce::GTC};
+  Price stop_price;  // Stop and StopLimit only
 
   Order(OrderID id, Symbol symbol, Side side, Quantity quantity, Price price)
       : id(id), symbol(symbol), side(side), quantity(quantity), price(price)
@@ -41,6 +80,11 @@ enum class ResultType
   CancelConfirm,
   BookEntry,
   Error,
+  BookHash,
+  TradeStats,
+  TradeBar,
+  MemoryUsage,
+  BookDelta,
 };
 
 std::ostream& operator<<(std::ostream& os, ResultType type) {
@@ -57,6 +101,21 @@ std::ostream& operator<<(std::ostream& os, ResultType type) {
     case ResultType::Error:
       os << "E";
       break;
+    case ResultType::BookHash:
+      os << "H";
+      break;
+    case ResultType::TradeStats:
+      os << "T";
+      break;
+    case ResultType::TradeBar:
+      os << "B";
+      break;
+    case ResultType::MemoryUsage:
+      os << "M";
+      break;
+    case ResultType::BookDelta:
+      os << "D";
+      break;
   }
   return os;
 }
@@ -70,6 +129,10 @@ struct Result
   Quantity quantity;
   Price price;
   std::string_view error_message;
+  uint64_t value{0};  // BookHash: the hash, MemoryUsage: bytes
+  // TradeStats and TradeBar only; points into the matcher like error_message
+  // points to a literal, so it is valid until the book runs the next action
+  hft::TradeBar const * bar{nullptr};
 
   static Result FillConfirm(OrderID id,  Symbol const & s, Quantity q, Price price)
   {
@@ -87,9 +150,61 @@ struct Result
   {
     return {ResultType::BookEntry, id, s, q, price, ""};
   }
+  // Open quantity of a resting order that changed since the last delta dump,
+  // 0 once it has left the book
+  static Result BookDelta(OrderID id, Symbol const &s, Quantity q, Price price)
+  {
+    return {ResultType::BookDelta, id, s, q, price, ""};
+  }
+  // Symbol is empty for the hash of the whole book
+  static Result BookHash(Symbol const &s, uint64_t hash)
+  {
+    return {ResultType::BookHash, 0, s, 0, Price(0), "", hash};
+  }
+  // Bytes used for one category (error_message holds its name); symbol is
+  // empty for the whole book
+  static Result MemoryUsage(Symbol const &s, std::string_view category, uint64_t bytes)
+  {
+    return {ResultType::MemoryUsage, 0, s, 0, Price(0), category, bytes};
+  }
+  static Result TradeStats(Symbol const &s, hft::TradeBar const & session)
+  {
+    return {ResultType::TradeStats, 0, s, 0, Price(0), "", 0, &session};
+  }
+  // order_id is the bar number
+  static Result TradeBar(Symbol const &s, OrderID index, hft::TradeBar const & bar)
+  {
+    return {ResultType::TradeBar, index, s, 0, Price(0), "", 0, &bar};
+  }
 };
 
 std::ostream& operator<<(std::ostream& os, const Result& r) {
+  if (r.type == ResultType::BookHash) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(r.value));
+    os << r.type;
+    if (!r.symbol.view().empty()) {
+      os << " " << r.symbol;
+    }
+    os << " " << hex;
+    return os;
+  }
+  if (r.type == ResultType::MemoryUsage) {
+    os << r.type;
+    if (!r.symbol.view().empty()) {
+      os << " " << r.symbol;
+    }
+    os << " " << r.error_message << " " << r.value;
+    return os;
+  }
+  if (r.type == ResultType::TradeStats) {
+    os << r.type << " " << r.symbol << " " << *r.bar;
+    return os;
+  }
+  if (r.type == ResultType::TradeBar) {
+    os << r.type << " " << r.symbol << " " << r.order_id << " " << *r.bar;
+    return os;
+  }
   os << r.type << " " << r.order_id;
   if (r.type == ResultType::FillConfirm) {
     os << " " << r.symbol << " " << r.quantity << " " << r.price;
@@ -100,7 +215,7 @@ std::ostream& operator<<(std::ostream& os, const Result& r) {
   else if (r.type == ResultType::Error) {
     os << " " << r.error_message;
   }
-  else if (r.type == ResultType::BookEntry) {
+  else if (r.type == ResultType::BookEntry || r.type == ResultType::BookDelta) {
     os << " " << r.symbol << " " << r.quantity << " " << r.price;
   }
   return os;
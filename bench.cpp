@@ -0,0 +1,575 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include "Action.hpp"
+#include "ActionBatch.hpp"
+#include "BookFork.hpp"
+#include "FieldDecode.hpp"
+#include "HugePageArena.hpp"
+#include "MultiSymbolBook.hpp"
+#include "PerfCounters.hpp"
+#include "Price.hpp"
+#include "ThreadTuning.hpp"
+#include "TradeTape.hpp"
+
+/*
+** Micro benchmarks.
+** usage: bench [--perf] [NAME...]
+**   NAME    runs the benchmarks whose name starts with any NAME
+**   --perf  also reports hardware counters per operation (PerfCounters.hpp)
+*/
+
+template <typename T>
+inline void doNotOptimize(T const & value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Prints counts divided by n, one "name value" pair per available event
+auto printCounts(hft::PerfCounters::Counts const & counts, double n) -> void {
+  using hft::PerfCounters;
+  std::cout << std::fixed << std::setprecision(2);
+  for (size_t e = 0; e < PerfCounters::NumEvents; ++e) {
+    std::cout << "  " << PerfCounters::name(static_cast<PerfCounters::Event>(e)) << " ";
+    if (counts[e]) {
+      std::cout << *counts[e] / n;
+    }
+    else {
+      std::cout << "n/a";
+    }
+  }
+  std::cout << std::endl;
+}
+
+// Random place/cancel flow around a moving mid on a few symbols; first is
+// true for a place, false for a cancel of second.id
+auto mixedFlow(size_t nactions) -> std::vector<std::pair<bool, hft::Order>> {
+  using namespace hft;
+  std::mt19937 gen(3);
+  std::vector<std::pair<bool, Order>> actions;
+  std::vector<Symbol> symbols{"IBM", "AAPL", "MSFT", "GOOG", "TSLA", "AMZN", "NVDA", "META"};
+  OrderID next_id = 1;
+  for (size_t i = 0; i < nactions; ++i) {
+    if (gen() % 4 || next_id < 100) {
+      auto side = gen() % 2 ? Side::Buy : Side::Sell;
+      // Mostly passive, one in five crosses the spread
+      auto offset = static_cast<int64_t>(gen() % 50) * 1000 - (gen() % 5 == 0 ? 30'000 : 0);
+      Price price(100'000'000 + (side == Side::Buy ? -offset : offset));
+      actions.emplace_back(true, Order(next_id++, symbols[gen() % symbols.size()], side,
+                                       static_cast<Quantity>(1 + gen() % 100), price));
+    }
+    else {
+      actions.emplace_back(false, Order(1 + gen() % (next_id - 1), Symbol(), Side::Buy, 0, Price()));
+    }
+  }
+  return actions;
+}
+
+auto runFlowAction(hft::MultiSymbolBook & book, std::pair<bool, hft::Order> const & action) -> void {
+  if (action.first) {
+    book.add(action.second);
+  }
+  else {
+    book.cancel(action.second.id);
+  }
+  doNotOptimize(book.getResults().size());
+}
+
+struct Bench {
+  std::vector<std::string> filters;
+  std::unique_ptr<hft::PerfCounters> perf;  // null unless --perf
+
+  auto enabled(std::string_view name) const -> bool {
+    if (filters.empty()) return true;
+    for (auto const & f : filters) {
+      if (name.starts_with(f)) return true;
+    }
+    return false;
+  }
+
+  // Runs f (which performs nops operations) a few times and reports the best ns/op
+  template <typename F>
+  auto run(std::string_view name, size_t nops, F && f) const -> void {
+    run(name, nops, [] {}, f);
+  }
+
+  // Same, with an untimed setup before every run
+  template <typename S, typename F>
+  auto run(std::string_view name, size_t nops, S && setup, F && f) const -> void {
+    if (!enabled(name)) return;
+    constexpr int reps = 5;
+    double best = std::numeric_limits<double>::max();
+    if (perf) {
+      perf->reset();
+    }
+    for (int rep = 0; rep < reps; ++rep) {
+      setup();
+      if (perf) {
+        perf->start();
+      }
+      auto start = std::chrono::steady_clock::now();
+      f();
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      if (perf) {
+        perf->stop();
+      }
+      best = std::min(best, elapsed.count() / static_cast<double>(nops));
+    }
+    std::cout << std::setw(32) << std::left << name << std::setw(10) << std::right
+              << std::fixed << std::setprecision(2) << best << " ns/op" << std::endl;
+    if (perf) {
+      printCounts(perf->read(), static_cast<double>(nops * reps));
+    }
+  }
+};
+
+// Price::fromString as it was before FieldDecode.hpp, kept as the baseline
+auto legacyPrice(std::string_view s, int64_t & val) -> bool {
+  auto dot = s.find('.');
+  if (dot == std::string_view::npos || dot > 7 || s.size() - dot - 1 != 5) {
+    return false;
+  }
+  auto integral = std::stoll(std::string(s.substr(0, dot)));
+  auto decimal = std::stoll(std::string(s.substr(dot + 1)));
+  if (integral < 0 || decimal < 0) {
+    return false;
+  }
+  val = integral * 1'000'000 + decimal;
+  return true;
+}
+
+auto benchFieldDecode(Bench const & bench) -> void {
+  constexpr size_t n = 1 << 16;
+  std::mt19937 gen(1);
+  std::vector<std::string> prices, ids, quantities;
+  for (size_t i = 0; i < n; ++i) {
+    prices.push_back(std::to_string(1 + gen() % 9'999'999) + "." + std::to_string(10000 + gen() % 90000));
+    ids.push_back(std::to_string(gen()));
+    quantities.push_back(std::to_string(1 + gen() % 65535));
+  }
+
+  bench.run("decode/price/legacy", n, [&] {
+    for (auto const & s : prices) {
+      int64_t val = 0;
+      doNotOptimize(legacyPrice(s, val));
+      doNotOptimize(val);
+    }
+  });
+  bench.run("decode/price/scalar", n, [&] {
+    for (auto const & s : prices) {
+      int64_t val = 0;
+      doNotOptimize(hft::decodePriceScalar(s, val));
+      doNotOptimize(val);
+    }
+  });
+#if defined(__SSE4_1__)
+  bench.run("decode/price/simd", n, [&] {
+    for (auto const & s : prices) {
+      int64_t val = 0;
+      doNotOptimize(hft::decodePriceSimd(s, val));
+      doNotOptimize(val);
+    }
+  });
+#endif
+
+  for (auto const & [name, fields] : {std::pair{"id", &ids}, std::pair{"quantity", &quantities}}) {
+    auto const & strings = *fields;
+    bench.run(std::string("decode/") + name + "/istream", n, [&] {
+      for (auto const & s : strings) {
+        std::istringstream is(s);
+        uint64_t val = 0;
+        is >> val;
+        doNotOptimize(val);
+      }
+    });
+    bench.run(std::string("decode/") + name + "/scalar", n, [&] {
+      for (auto const & s : strings) {
+        uint64_t val = 0;
+        doNotOptimize(hft::decodeUnsignedScalar(s, val));
+        doNotOptimize(val);
+      }
+    });
+#if defined(__SSE4_1__)
+    bench.run(std::string("decode/") + name + "/simd", n, [&] {
+      for (auto const & s : strings) {
+        uint64_t val = 0;
+        doNotOptimize(hft::decodeUnsignedSimd(s, val));
+        doNotOptimize(val);
+      }
+    });
+#endif
+  }
+}
+
+auto benchBook(Bench const & bench) -> void {
+  using namespace hft;
+
+  // Aggressive buys walk a deep book of small resting sells. Order ids are
+  // shuffled so the order map is scattered over memory as in a live session.
+  constexpr int levels = 10'000, per_level = 60, sweeps = 10;
+  constexpr int norders = levels * per_level;
+  std::unique_ptr<MultiSymbolBook> book;
+  auto fill_book = [&] {
+    std::mt19937 gen(2);
+    std::vector<OrderID> ids(norders);
+    std::iota(ids.begin(), ids.end(), 1);
+    std::shuffle(ids.begin(), ids.end(), gen);
+    book = std::make_unique<MultiSymbolBook>();
+    for (int level = 0, i = 0; level < levels; ++level) {
+      Price price(100'000'000 + level);
+      for (int j = 0; j < per_level; ++j) {
+        book->add(Order(ids[i++], "IBM", Side::Sell, 1, price));
+      }
+    }
+  };
+  bench.run("book/deep-sweep", norders, fill_book, [&] {
+    for (int i = 0; i < sweeps; ++i) {
+      book->add(Order(norders + 1 + i, "IBM", Side::Buy, norders / sweeps, Price(200'000'000)));
+      doNotOptimize(book->getResults().size());
+    }
+  });
+  // The same sweeps recording every fill on a trade tape; the encoding and
+  // writing happen on the tape's thread, so with a core of its own this
+  // measures the ring handoff, and with a shared core the writer's work too
+  std::unique_ptr<TradeTape> tape;
+  auto fill_taped_book = [&] {
+    book.reset();
+    tape = std::make_unique<TradeTape>("/dev/null");
+    fill_book();
+    book->setTradeTape(tape.get());
+  };
+  bench.run("book/deep-sweep-tape", norders, fill_taped_book, [&] {
+    for (int i = 0; i < sweeps; ++i) {
+      book->add(Order(norders + 1 + i, "IBM", Side::Buy, norders / sweeps, Price(200'000'000)));
+      doNotOptimize(book->getResults().size());
+    }
+  });
+  book.reset();
+  tape.reset();
+  bench.run("book/deep-print", norders, fill_book, [&] {
+    book->print();
+    doNotOptimize(book->getResults().size());
+  });
+  // The same walk without the results buffer, as app streams P
+  bench.run("book/deep-print-stream", norders, fill_book, [&] {
+    for (auto const & entry : book->entries()) {
+      doNotOptimize(entry.order_id);
+    }
+  });
+  // Monitoring polls of the deep book after a few changes each: the delta dump
+  // only compares the levels they touched, P lists all the orders again
+  constexpr int npolls = 1000;
+  auto fill_dumped_book = [&] {
+    fill_book();
+    book->printDelta("");
+  };
+  bench.run("book/deep-delta", npolls, fill_dumped_book, [&] {
+    for (int i = 0; i < npolls; ++i) {
+      book->add(Order(norders + 1 + i, "IBM", Side::Buy, 3, Price(200'000'000)));
+      book->printDelta("");
+      doNotOptimize(book->getResults().size());
+    }
+  });
+  // Fork the deep book and ask what a small buy would fill, on the deep book
+  constexpr int nforks = 10'000;
+  bench.run("book/fork-what-if", nforks, fill_book, [&] {
+    for (int i = 0; i < nforks; ++i) {
+      BookFork fork(*book, {"IBM"});
+      fork.add(Order(norders + 1, "IBM", Side::Buy, 5, Price(200'000'000)));
+      doNotOptimize(fork.getResults().size());
+    }
+  });
+
+  constexpr size_t nactions = 200'000;
+  auto actions = mixedFlow(nactions);
+  bench.run("book/mixed", nactions, [&] { book = std::make_unique<MultiSymbolBook>(); }, [&] {
+    for (auto const & action : actions) {
+      runFlowAction(*book, action);
+    }
+  });
+
+  // The same flow decoded into actions and run through runBatch: size 1 runs
+  // without hints, larger batches prefetch ahead (see ActionBatch.hpp)
+  std::vector<Action> decoded;
+  for (auto const & [place, order] : actions) {
+    // The flow's raw prices have no text form, so the order is set directly
+    decoded.emplace_back(place ? "O 1 IBM B 1 1.00000" : "X 1");
+    decoded.back().order = order;
+  }
+  for (size_t batch_size : {1, 8, 32, 128, 1024}) {
+    bench.run("book/batch/" + std::to_string(batch_size), nactions,
+              [&] { book = std::make_unique<MultiSymbolBook>(); }, [&] {
+      runBatch(*book, decoded, batch_size, [](size_t, std::vector<Result> const & results) {
+        doNotOptimize(results.size());
+      });
+    });
+  }
+
+  // Adds spread over many symbols, whose best levels are out of cache by the
+  // time an order comes back to them: what the hints are for
+  constexpr size_t nwide = 50'000;
+  std::mt19937 wide_gen(5);
+  std::vector<Action> wide_seed, wide_adds;
+  OrderID wide_id = 1;
+  for (size_t s = 0; s < nwide; ++s) {
+    for (int level = 0; level < 4; ++level) {
+      auto symbol = " W" + std::to_string(s);
+      wide_seed.emplace_back("O " + std::to_string(wide_id++) + symbol + " S 5 " + std::to_string(101 + level) + ".00000");
+      wide_seed.emplace_back("O " + std::to_string(wide_id++) + symbol + " B 5 " + std::to_string(99 - level) + ".00000");
+    }
+  }
+  for (size_t i = 0; i < nactions; ++i) {
+    auto symbol = " W" + std::to_string(wide_gen() % nwide);
+    bool buy = wide_gen() % 2;
+    auto price = buy ? 95 + wide_gen() % 5 : 101 + wide_gen() % 5;
+    wide_adds.emplace_back("O " + std::to_string(wide_id++) + symbol + (buy ? " B 1 " : " S 1 ") +
+                           std::to_string(price) + ".00000");
+  }
+  auto fill_wide_book = [&] {
+    book = std::make_unique<MultiSymbolBook>();
+    runBatch(*book, wide_seed, 1, [](size_t, std::vector<Result> const &) {});
+  };
+  for (size_t batch_size : {1, 32}) {
+    bench.run("book/batch-wide/" + std::to_string(batch_size), nactions, fill_wide_book, [&] {
+      runBatch(*book, wide_adds, batch_size, [](size_t, std::vector<Result> const & results) {
+        doNotOptimize(results.size());
+      });
+    });
+  }
+}
+
+/*
+** Tail latency of single actions on the book/mixed flow, reported as
+** percentiles of one run on a fresh book (page faults included):
+**   inline/    the action runs on the calling thread
+**   thread/    a matcher thread is handed one action at a time and the
+**              round trip is timed, waiting by blocking or spinning
+** Each is run with the book on the heap and on a pre-faulted huge-page arena.
+** Pinned spinning needs two CPUs, one per thread.
+*/
+auto benchLatency(Bench const & bench) -> void {
+  using namespace hft;
+  if (!bench.enabled("latency")) return;
+
+  constexpr size_t nactions = 200'000;
+  constexpr size_t arena_bytes = 256 << 20;
+  auto actions = mixedFlow(nactions);
+  std::vector<double> ns(nactions);
+
+  auto report = [&](std::string_view name) {
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[std::min(ns.size() - 1, static_cast<size_t>(q * ns.size()))]; };
+    std::cout << std::setw(32) << std::left << name << std::right << std::fixed << std::setprecision(0)
+              << " p50 " << std::setw(6) << at(0.5) << " p99 " << std::setw(6) << at(0.99)
+              << " p999 " << std::setw(7) << at(0.999) << " max " << std::setw(8) << ns.back() << " ns" << std::endl;
+  };
+  auto elapsed = [](auto start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  };
+  auto makeBook = [&](bool arena, std::unique_ptr<BookArena> & memory) {
+    memory.reset();
+    if (!arena) {
+      return std::make_unique<MultiSymbolBook>();
+    }
+    memory = std::make_unique<BookArena>(arena_bytes);
+    return std::make_unique<MultiSymbolBook>(memory->resource());
+  };
+
+  for (bool arena : {false, true}) {
+    std::string name = std::string("latency/inline/") + (arena ? "arena" : "heap");
+    if (!bench.enabled(name)) continue;
+    std::unique_ptr<BookArena> memory;
+    auto book = makeBook(arena, memory);
+    for (size_t i = 0; i < nactions; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      runFlowAction(*book, actions[i]);
+      ns[i] = elapsed(start);
+    }
+    report(name);
+    if (memory) {
+      std::cout << "  arena " << memory->arena.backing() << " used " << (memory->arena.used() >> 20)
+                << " MB, overflow " << memory->arena.overflow() << " B";
+      if (!memory->arena.error().empty()) {
+        std::cout << " (" << memory->arena.error() << ")";
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  auto cpus = allowedCpus();
+  for (bool arena : {false, true}) {
+    for (auto wait : {WaitPolicy::Block, WaitPolicy::Spin}) {
+      std::string name = std::string("latency/thread/") + (wait == WaitPolicy::Spin ? "spin-pinned/" : "block/")
+          + (arena ? "arena" : "heap");
+      if (!bench.enabled(name)) continue;
+      if (wait == WaitPolicy::Spin && cpus.size() < 2) {
+        std::cout << std::setw(32) << std::left << name << " skipped, needs 2 CPUs" << std::endl;
+        continue;
+      }
+      std::unique_ptr<BookArena> memory;
+      auto book = makeBook(arena, memory);
+      std::atomic<uint64_t> posted{0}, done{0};
+      std::thread matcher([&] {
+        if (wait == WaitPolicy::Spin) {
+          pinCurrentThread(cpus[1]);
+        }
+        for (uint64_t k = 1; k <= nactions; ++k) {
+          waitWhileEqual(posted, k - 1, wait);
+          runFlowAction(*book, actions[k - 1]);
+          done.store(k, std::memory_order_release);
+          done.notify_one();
+        }
+      });
+      if (wait == WaitPolicy::Spin) {
+        pinCurrentThread(cpus[0]);
+      }
+      for (uint64_t k = 1; k <= nactions; ++k) {
+        auto start = std::chrono::steady_clock::now();
+        posted.store(k, std::memory_order_release);
+        posted.notify_one();
+        waitWhileEqual(done, k - 1, wait);
+        ns[k - 1] = elapsed(start);
+      }
+      matcher.join();
+      setAllowedCpus(cpus);
+      report(name);
+    }
+  }
+}
+
+// One phase of benchPipeline, accumulated over all batches
+struct PipelinePhase {
+  std::string_view name;
+  std::unique_ptr<hft::PerfCounters> perf;
+  double ns = 0;
+
+  template <typename F>
+  auto run(F && f) -> void {
+    if (perf) perf->start();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    if (perf) perf->stop();
+    ns += elapsed.count();
+  }
+};
+
+/*
+** The app's pipeline split into phases, each timed (and counted with --perf)
+** separately over batches of lines:
+**   parse   text line -> Action
+**   match   Action -> book results
+**   format  results -> text, each result written with operator<< and a
+**           '\n' into a stream buffer, as App::write does into std::cout
+**   print   text -> output stream, what std::cout does when its buffer fills
+*/
+auto benchPipeline(Bench const & bench) -> void {
+  using namespace hft;
+  if (!bench.enabled("pipeline")) return;
+
+  constexpr size_t nlines = 200'000, batch = 1024;
+  std::mt19937 gen(4);
+  std::vector<std::string> symbols{"IBM", "AAPL", "MSFT", "GOOG", "TSLA", "AMZN", "NVDA", "META"};
+  std::vector<std::string> lines;
+  for (size_t i = 0, id = 1; i < nlines; ++i) {
+    if (i % 20'000 == 19'999) {
+      lines.push_back("P");
+    }
+    else if (gen() % 4 || id < 100) {
+      bool buy = gen() % 2;
+      auto offset = static_cast<int>(gen() % 50) - (gen() % 5 == 0 ? 30 : 0);
+      auto price = 1000 + (buy ? -offset : offset);
+      lines.push_back("O " + std::to_string(id++) + " " + symbols[gen() % symbols.size()] +
+                      (buy ? " B " : " S ") + std::to_string(1 + gen() % 100) + " " +
+                      std::to_string(price / 10) + "." + std::to_string(price % 10) + "0000");
+    }
+    else {
+      lines.push_back("X " + std::to_string(1 + gen() % (id - 1)));
+    }
+  }
+
+  std::array<PipelinePhase, 4> phases{{{"parse", {}}, {"match", {}}, {"format", {}}, {"print", {}}}};
+  if (bench.perf) {
+    for (auto & phase : phases) {
+      phase.perf = std::make_unique<PerfCounters>();
+    }
+  }
+
+  MultiSymbolBook book;
+  std::ofstream out("/dev/null");
+  std::vector<Action> actions;
+  std::vector<Result> results;
+  std::ostringstream text;
+  for (size_t first = 0; first < nlines; first += batch) {
+    auto last = std::min(first + batch, nlines);
+    actions.clear();
+    results.clear();
+    text.str({});
+    phases[0].run([&] {
+      for (auto i = first; i < last; ++i) {
+        actions.emplace_back(lines[i]);
+      }
+    });
+    phases[1].run([&] {
+      for (auto const & action : actions) {
+        switch (action.type) {
+          case ActionType::Place : book.add(action.order); break;
+          case ActionType::Cancel : book.cancel(action.order.id); break;
+          case ActionType::Print : book.print(); break;
+          default: break;
+        }
+        results.insert(results.end(), book.getResults().begin(), book.getResults().end());
+      }
+    });
+    phases[2].run([&] {
+      for (auto const & r : results) {
+        text << r << '\n';
+      }
+    });
+    phases[3].run([&] {
+      out << text.view();
+    });
+  }
+
+  for (auto & phase : phases) {
+    auto name = "pipeline/" + std::string(phase.name);
+    std::cout << std::setw(32) << std::left << name << std::setw(10) << std::right
+              << std::fixed << std::setprecision(2) << phase.ns / nlines << " ns/action" << std::endl;
+    if (phase.perf) {
+      printCounts(phase.perf->read(), nlines);
+    }
+  }
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+  Bench bench;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--perf")) {
+      bench.perf = std::make_unique<hft::PerfCounters>();
+    }
+    else {
+      bench.filters.emplace_back(argv[i]);
+    }
+  }
+  if (bench.perf && !bench.perf->available()) {
+    std::cout << "hardware counters unavailable (" << bench.perf->error() << "), timing only" << std::endl;
+    bench.perf.reset();
+  }
+  else if (bench.perf && !bench.perf->error().empty()) {
+    std::cout << "some hardware counters unavailable (" << bench.perf->error() << ")" << std::endl;
+  }
+  benchFieldDecode(bench);
+  benchBook(bench);
+  benchPipeline(bench);
+  benchLatency(bench);
+  return EXIT_SUCCESS;
+}
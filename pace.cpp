@@ -0,0 +1,70 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "PacedReplay.hpp"
+
+/*
+** Replays a capture written by app --capture at its original pace and
+** reports the latency from each line's scheduled arrival to its results.
+** usage: pace [--speed X] [--burst-gap NS] [--spin] [--out FILE] CAPTURE
+** --speed X replays X times faster than captured (0: as fast as possible),
+** --burst-gap sets how far apart (in capture time) lines may be and still
+** belong to one burst, 1 ms by default. --spin busy-waits for arrivals
+** instead of sleeping. The results go to --out FILE, and are dropped otherwise.
+** Prints one line per burst, then one for the whole replay:
+**   burst LINE span SPAN_NS actions N p50 NS p99 NS p999 NS max NS ns
+**   all N p50 NS p99 NS p999 NS max NS ns
+*/
+auto main(int argc, char *argv[]) -> int
+{
+  double speed = 1;
+  uint64_t burst_gap_ns = 1'000'000;
+  auto wait = hft::WaitPolicy::Block;
+  std::string capture_name;
+  std::string out_name;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      if (!std::strcmp(argv[i], "--speed") && i + 1 < argc) {
+        speed = std::stod(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--burst-gap") && i + 1 < argc) {
+        burst_gap_ns = std::stoull(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--spin")) {
+        wait = hft::WaitPolicy::Spin;
+      }
+      else if (!std::strcmp(argv[i], "--out") && i + 1 < argc) {
+        out_name = argv[++i];
+      }
+      else {
+        capture_name = argv[i];
+      }
+    }
+    std::ifstream capture(capture_name);
+    if (capture_name.empty() || !capture) {
+      std::cerr << "usage: pace [--speed X] [--burst-gap NS] [--spin] [--out FILE] CAPTURE" << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto actions = hft::readCapture(capture);
+
+    hft::MultiSymbolBook book;
+    std::ofstream out;
+    if (!out_name.empty()) {
+      out.open(out_name);
+    }
+    else {
+      out.setstate(std::ios::badbit);  // discards the results
+    }
+    auto report = hft::PacedReplay(speed, burst_gap_ns, wait).run(book, actions, out);
+    for (auto const & burst : report.bursts) {
+      std::cout << "burst " << burst.first + 1 << " span " << burst.span_ns << " actions " << burst.latency << '\n';
+    }
+    std::cout << "all " << report.all << std::endl;
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
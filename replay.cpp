@@ -0,0 +1,67 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ParallelReplay.hpp"
+
+/*
+** Offline replay of an actions file.
+** usage: replay [-j THREADS] [--cpus LIST] [--sequential] [FILE]
+** Symbols are matched in parallel and the output is merged back into the
+** original line order (see ParallelReplay.hpp for the P merge rule).
+** --cpus pins the threads to a CPU list such as 2-5 or 1,3.
+** --sequential replays through a single book for reference.
+*/
+auto main(int argc, char *argv[]) -> int
+{
+  std::string file_name{"actions.txt"};
+  size_t nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+  bool sequential = false;
+  hft::ThreadOptions options;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      if (!std::strcmp(argv[i], "-j") && i + 1 < argc) {
+        nthreads = std::stoul(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--cpus") && i + 1 < argc) {
+        options.cpus = hft::parseCpuList(argv[++i]);
+      }
+      else if (!std::strcmp(argv[i], "--sequential")) {
+        sequential = true;
+      }
+      else {
+        file_name = argv[i];
+      }
+    }
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "usage: replay [-j THREADS] [--cpus LIST] [--sequential] [FILE]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!std::filesystem::exists(file_name)) {
+    std::cerr << "File '" << file_name << "'" << " does not exist" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> lines;
+  std::string line;
+  std::ifstream actions(file_name, std::ios::in);
+  while (std::getline(actions, line)) {
+    if (line.empty()) continue;
+    lines.push_back(std::move(line));
+  }
+
+  std::ios::sync_with_stdio(false);
+  if (sequential) {
+    hft::ParallelReplay::runSequential(lines, std::cout);
+  }
+  else {
+    hft::ParallelReplay(nthreads, options).run(lines, std::cout);
+  }
+  std::cout.flush();
+  return EXIT_SUCCESS;
+}
@@ -1,10 +1,18 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <random>
+#include <filesystem>
 #include "Price.hpp"
 #include "OrderMatcher.hpp"
 #include "Action.hpp"
 #include "MultiSymbolBook.hpp"
+#include "ParallelReplay.hpp"
+#include "HugePageArena.hpp"
+#include "BookFork.hpp"
+#include "TradeTape.hpp"
+#include "ActionBatch.hpp"
+#include "PacedReplay.hpp"
 
 using namespace hft;
 
@@ -62,7 +70,7 @@ auto test_highest_bidder() -> bool {
         Order(3, "IBM", Side::Buy, 1500, Price("200.00000")),
         Order(4, "IBM", Side::Buy, 100, Price("100.00000")),
         Order(5, "IBM", Side::Sell, 10, Price("90.00000"))};
-    std::unordered_map<OrderID, Order> orders;
+    OrderMap orders;
     for (auto const &o : olist) {
       orders[o.id] = std::move(o);
     }
@@ -123,7 +131,7 @@ auto test_highest_bidder() -> bool {
         Order(4, "IBM", Side::Buy, 15, Price("200.00000")),
         Order(5, "IBM", Side::Buy, 1500, Price("201.00000")),
     };
-    std::unordered_map<OrderID, Order> orders;
+    OrderMap orders;
     for (auto const &o : olist) {
       orders[o.id] = std::move(o);
     }
@@ -165,7 +173,7 @@ auto test_matcher() -> bool {
     // -->
     // "F 10003 IBM 5 100.00000"
     // "F 10000 IBM 5 100.00000"
-    std::unordered_map<OrderID, Order> orders;
+    OrderMap orders;
     orders[10000] = Order(10000, "IBM", Side::Buy, 10, Price("100.00000"));
     orders[10001] = Order(10001, "IBM", Side::Buy, 10, Price("99.00000"));
     orders[10002] = Order(10002, "IBM", Side::Sell, 5, Price("101.00000"));
@@ -195,7 +203,7 @@ auto test_matcher() -> bool {
 }
 
 auto test_cancellation() -> bool {
-  std::unordered_map<OrderID, Order> orders;
+  OrderMap orders;
   orders[10000] = Order(10000, "Google", Side::Buy, 10, Price("100.00000"));
   orders[10001] = Order(10001, "Google", Side::Buy, 10, Price("99.00000"));
   orders[10002] = Order(10002, "Google", Side::Sell, 5, Price("101.00000"));
@@ -268,6 +276,88 @@ auto test_action() -> bool {
   return true;
 }
 
+auto test_field_decode() -> bool {
+  using DS = DecodeStatus;
+  struct PriceCase { std::string_view s; DS status; int64_t val; };
+  std::vector<PriceCase> prices{
+    {"100.00000", DS::Ok, 100'000'000},
+    {"0.00001", DS::Ok, 1},
+    {"1.99999", DS::Ok, 1'099'999},
+    {"9999999.99999", DS::Ok, 9'999'999'099'999},
+    {"100.0000", DS::BadFormat, 0},
+    {"100.000000", DS::BadFormat, 0},
+    {"10000000.00000", DS::BadFormat, 0},
+    {"100", DS::BadFormat, 0},
+    {"", DS::BadFormat, 0},
+    {"1.2.00000", DS::BadFormat, 0},
+    {".00000", DS::BadDigit, 0},
+    {"1a0.00000", DS::BadDigit, 0},
+    {"-10.00000", DS::BadFormat, 0},
+    {"+10.00000", DS::BadFormat, 0},
+    {"1.-1234", DS::BadFormat, 0},
+    {"10.0000x", DS::BadDigit, 0},
+    {"10.00.00", DS::BadDigit, 0},
+    {"10.000.0", DS::BadDigit, 0},
+  };
+  for (auto const & c : prices) {
+    int64_t val = 0;
+    CHECK_EQUAL(decodePriceScalar(c.s, val), c.status);
+    if (c.status == DS::Ok) {
+      CHECK_EQUAL(val, c.val);
+    }
+#if defined(__SSE4_1__)
+    int64_t simd = 0;
+    CHECK_EQUAL(decodePriceSimd(c.s, simd), c.status);
+    CHECK_EQUAL(simd, val);
+#endif
+  }
+
+  std::mt19937 gen(7);
+  for (int i = 0; i < 10000; ++i) {
+    auto n = gen() % 21;
+    std::string s;
+    for (size_t j = 0; j < n; ++j) {
+      s.push_back(gen() % 16 ? static_cast<char>('0' + gen() % 10) : "./ a-+"[gen() % 6]);
+    }
+    uint64_t val = 0;
+    auto status = decodeUnsignedScalar(s, val);
+    if (status == DS::Ok && s.size() <= 18) {
+      CHECK_EQUAL(val, std::stoull(s));
+    }
+#if defined(__SSE4_1__)
+    uint64_t simd = 0;
+    CHECK_EQUAL(decodeUnsignedSimd(s, simd), status);
+    CHECK_EQUAL(simd, val);
+    int64_t price = 0, simd_price = 0;
+    CHECK_EQUAL(decodePriceSimd(s, simd_price), decodePriceScalar(s, price));
+    CHECK_EQUAL(simd_price, price);
+#endif
+  }
+
+  try {
+    Price p("1x.00000");
+    std::cout << "Should have thrown p = " << p << std::endl;
+    return false;
+  } catch (std::invalid_argument const & e) {
+    // expected
+  }
+  for (auto bad : {"O 1x IBM B 10 100.00000", "O 1 IBM B 70000 100.00000",
+                   "O 4294967296 IBM B 10 100.00000", "O 1 IBM B 10 100.0", "X -1"}) {
+    try {
+      Action action(bad);
+      std::cout << "Should have thrown for '" << bad << "'" << std::endl;
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+  Action action("O 4294967295 IBM S 65535 9999999.99999");
+  CHECK_EQUAL(action.order.id, 4294967295u);
+  CHECK_EQUAL(action.order.quantity, 65535);
+  CHECK_EQUAL(action.order.price, Price("9999999.99999"));
+  return true;
+}
+
 auto test_multi_symbol_book() -> bool {
   MultiSymbolBook book;
   book.add(Order(10000, "Apple", Side::Buy, 10, Price("100.00000")));
@@ -340,6 +430,906 @@ auto test_multi_symbol_book() -> bool {
   return true;
 }
 
+auto test_book_entries() -> bool {
+  // The generator runs its body lazily, rethrows what it threw and can be moved from
+  auto counter = [](int n) -> Generator<int> {
+    for (int i = 0; i < n; ++i) {
+      if (i == 2 && n > 3) {
+        throw std::runtime_error("counter");
+      }
+      co_yield i;
+    }
+  };
+  std::vector<int> counted;
+  for (auto i : counter(3)) {
+    counted.push_back(i);
+  }
+  bool in_order = counted == std::vector<int>{0, 1, 2};
+  CHECK_EQUAL(in_order, true);
+  auto failing = counter(5);
+  auto it = failing.begin();
+  CHECK_EQUAL(*it, 0);
+  ++it;
+  CHECK_EQUAL(*it, 1);
+  try {
+    ++it;
+    return false;
+  } catch (std::runtime_error const & e) {
+    CHECK_EQUAL(std::string(e.what()), "counter");
+  }
+  auto source = counter(3);
+  auto target = std::move(source);
+  bool moved_empty = source.begin() == source.end();
+  CHECK_EQUAL(moved_empty, true);
+  CHECK_EQUAL(*target.begin(), 0);
+
+  // P streams symbols in lexicographic order, whatever order they were added in,
+  // then buys best-first and sells, FIFO within a level
+  MultiSymbolBook book;
+  book.add(Order(1, "MSFT", Side::Sell, 5, Price("11.00000")));
+  book.add(Order(2, "IBM", Side::Buy, 1, Price("99.00000")));
+  book.add(Order(3, "AAPL", Side::Sell, 2, Price("21.00000")));
+  book.add(Order(4, "IBM", Side::Buy, 2, Price("100.00000")));
+  book.add(Order(5, "AAPL", Side::Buy, 3, Price("20.00000")));
+  book.add(Order(6, "IBM", Side::Sell, 4, Price("101.00000")));
+  book.add(Order(7, "IBM", Side::Buy, 6, Price("99.00000")));
+  std::ostringstream streamed;
+  for (auto const & entry : book.printEntries()) {
+    streamed << entry << "|";
+  }
+  CHECK_EMPTY(book.getResults());
+  CHECK_EQUAL(streamed.str(), "P 5 AAPL 3 20.00000|P 3 AAPL 2 21.00000|"
+              "P 4 IBM 2 100.00000|P 2 IBM 1 99.00000|P 7 IBM 6 99.00000|P 6 IBM 4 101.00000|"
+              "P 1 MSFT 5 11.00000|");
+  book.print();
+  std::ostringstream printed;
+  for (auto const & r : book.getResults()) {
+    printed << r << "|";
+  }
+  CHECK_EQUAL(printed.str(), streamed.str());
+  return true;
+}
+
+auto test_mass_cancel() -> bool {
+  {
+    Action all("C");
+    CHECK_EQUAL(all.type, ActionType::MassCancel);
+    CHECK_EQUAL(all.scope, CancelScope::Book);
+    Action symbol("C IBM");
+    CHECK_EQUAL(symbol.scope, CancelScope::Symbol);
+    CHECK_EQUAL(symbol.order.symbol, "IBM");
+    Action side("C IBM S");
+    CHECK_EQUAL(side.scope, CancelScope::Side);
+    CHECK_EQUAL(side.order.side, Side::Sell);
+    try {
+      Action bad("C IBM Q");
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+
+  MultiSymbolBook book;
+  book.add(Order(1, "IBM", Side::Buy, 10, Price("99.00000")));
+  book.add(Order(2, "IBM", Side::Buy, 10, Price("100.00000")));
+  book.add(Order(3, "IBM", Side::Buy, 10, Price("99.00000")));
+  book.add(Order(4, "IBM", Side::Sell, 10, Price("102.00000")));
+  book.add(Order(5, "IBM", Side::Sell, 10, Price("101.00000")));
+  book.add(Order(6, "MSFT", Side::Sell, 10, Price("50.00000")));
+  book.add(Order(7, "AAPL", Side::Buy, 10, Price("50.00000")));
+
+  // Best level first, FIFO within a level
+  book.cancelSide("IBM", Side::Buy);
+  CHECK_EQUAL(book.getResults().size(), 3);
+  CHECK_EQUAL(book.getResults()[0].order_id, 2);
+  CHECK_EQUAL(book.getResults()[1].order_id, 1);
+  CHECK_EQUAL(book.getResults()[2].order_id, 3);
+  for (auto const & r : book.getResults()) {
+    CHECK_EQUAL(r.type, ResultType::CancelConfirm);
+  }
+  book.cancel(1);
+  CHECK_EQUAL(book.getResults()[0].type, ResultType::Error);
+
+  book.cancelSymbol("GOOG");
+  CHECK_EMPTY(book.getResults());
+
+  // Symbols in lexicographic order
+  book.cancelAll();
+  CHECK_EQUAL(book.getResults().size(), 4);
+  CHECK_EQUAL(book.getResults()[0].order_id, 7);
+  CHECK_EQUAL(book.getResults()[1].order_id, 5);
+  CHECK_EQUAL(book.getResults()[2].order_id, 4);
+  CHECK_EQUAL(book.getResults()[3].order_id, 6);
+
+  book.print();
+  CHECK_EMPTY(book.getResults());
+  // Cancelled ids are free again
+  book.add(Order(2, "IBM", Side::Sell, 10, Price("100.00000")));
+  CHECK_EMPTY(book.getResults());
+  return true;
+}
+
+auto test_book_hash() -> bool {
+  MultiSymbolBook a;
+  CHECK_EQUAL(a.hash(), 0);
+  a.add(Order(1, "IBM", Side::Buy, 10, Price("100.00000")));
+  a.cancel(1);
+  CHECK_EQUAL(a.hash(), 0);
+
+  // A partial fill leaves the same state as placing the remainder directly
+  a.add(Order(2, "IBM", Side::Buy, 10, Price("100.00000")));
+  a.add(Order(3, "IBM", Side::Sell, 4, Price("99.00000")));
+  a.add(Order(4, "MSFT", Side::Sell, 7, Price("10.00000")));
+  MultiSymbolBook b;
+  b.add(Order(2, "IBM", Side::Buy, 6, Price("100.00000")));
+  b.add(Order(4, "MSFT", Side::Sell, 7, Price("10.00000")));
+  CHECK_EQUAL(a.hash(), b.hash());
+  CHECK_EQUAL(a.hash("IBM"), b.hash("IBM"));
+  CHECK_EQUAL(a.hash(), a.hash("IBM") + a.hash("MSFT"));
+  CHECK_EQUAL(a.hash("GOOG"), 0);
+
+  // Quantity, price and queue position all matter
+  b.add(Order(5, "IBM", Side::Buy, 1, Price("100.00000")));
+  b.add(Order(6, "IBM", Side::Buy, 1, Price("100.00000")));
+  a.add(Order(6, "IBM", Side::Buy, 1, Price("100.00000")));
+  a.add(Order(5, "IBM", Side::Buy, 1, Price("100.00000")));
+  if (a.hash() == b.hash()) {
+    std::cout << "Hashes of different books collide at " << __FILE__ << ":" << __LINE__ << std::endl;
+    return false;
+  }
+  a.cancel(6);
+  a.cancel(5);
+  b.cancel(5);
+  b.cancel(6);
+  CHECK_EQUAL(a.hash(), b.hash());
+  b.add(Order(7, "IBM", Side::Buy, 1, Price("99.00000")));
+  if (a.hash() == b.hash()) {
+    std::cout << "Hashes of different books collide at " << __FILE__ << ":" << __LINE__ << std::endl;
+    return false;
+  }
+
+  // Filling or cancelling everything empties the hash
+  b.add(Order(8, "IBM", Side::Sell, 7, Price("99.00000")));
+  CHECK_EQUAL(b.hash("IBM"), 0);
+  a.cancelSide("MSFT", Side::Sell);
+  CHECK_EQUAL(a.hash(), a.hash("IBM"));
+  a.cancelAll();
+  CHECK_EQUAL(a.hash(), 0);
+
+  Action whole("H");
+  CHECK_EQUAL(whole.type, ActionType::Hash);
+  b.printHash(whole.order.symbol);
+  std::ostringstream os;
+  os << b.getResults()[0];
+  CHECK_EQUAL(os.str().size(), 18);
+  Action ibm("H IBM");
+  b.printHash(ibm.order.symbol);
+  os.str("");
+  os << b.getResults()[0];
+  CHECK_EQUAL(os.str(), std::string("H IBM 0000000000000000"));
+  return true;
+}
+
+auto test_stop_orders() -> bool {
+  {
+    Action stop("S 7 IBM S 5 99.00000");
+    CHECK_EQUAL(stop.type, ActionType::Place);
+    CHECK_EQUAL(stop.order.type, OrderType::Stop);
+    CHECK_EQUAL(stop.order.stop_price, Price("99.00000"));
+    Action stop_limit("S 7 IBM S 5 99.00000 98.00000");
+    CHECK_EQUAL(stop_limit.order.type, OrderType::StopLimit);
+    CHECK_EQUAL(stop_limit.order.price, Price("98.00000"));
+    try {
+      Action bad("S 7 IBM S 5");
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+
+  MultiSymbolBook book;
+  // Runs an action line and joins its results with '|'
+  auto run = [&book](std::string const & line) {
+    Action a(line);
+    switch (a.type) {
+      case ActionType::Place : book.add(a.order); break;
+      case ActionType::Cancel : book.cancel(a.order.id); break;
+      default: book.cancelSymbol(a.order.symbol); break;
+    }
+    std::ostringstream os;
+    for (auto const & r : book.getResults()) {
+      os << (os.tellp() ? "|" : "") << r;
+    }
+    return os.str();
+  };
+
+  // Without a trade nothing triggers
+  CHECK_EQUAL(run("S 1 IBM B 1 101.00000"), "");
+  CHECK_EQUAL(run("S 2 IBM B 2 102.00000 103.00000"), "");
+  CHECK_EQUAL(run("S 3 IBM B 1 105.00000"), "");
+  CHECK_EQUAL(run("O 10 IBM S 1 101.00000"), "");
+  CHECK_EQUAL(run("O 11 IBM S 1 102.00000"), "");
+  CHECK_EQUAL(run("O 12 IBM S 5 103.00000"), "");
+  auto hash = book.hash();
+
+  // The trade at 101 triggers stop 1, whose market fill at 102 triggers stop 2
+  CHECK_EQUAL(run("O 20 IBM B 1 101.00000"),
+              "F 10 IBM 1 101.00000|F 20 IBM 1 101.00000|"
+              "F 11 IBM 1 102.00000|F 1 IBM 1 102.00000|"
+              "F 12 IBM 2 103.00000|F 2 IBM 2 103.00000");
+  // A stop crossed at placement triggers at once; a market remainder is cancelled
+  CHECK_EQUAL(run("S 4 IBM B 10 100.00000"), "F 12 IBM 3 103.00000|F 4 IBM 3 103.00000|X 4");
+  CHECK_EQUAL(book.hash(), 0);
+
+  // Pending stops are off the book hash and can be cancelled
+  CHECK_EQUAL(run("O 13 IBM S 5 103.00000"), "");
+  if (book.hash() == hash) {
+    std::cout << "Stop orders changed the book hash at " << __FILE__ << ":" << __LINE__ << std::endl;
+    return false;
+  }
+  CHECK_EQUAL(run("X 3"), "X 3");
+  CHECK_EQUAL(run("X 3"), "E 3 Order does not exist");
+
+  // A market order fills level by level
+  CHECK_EQUAL(run("O 14 IBM S 5 104.00000"), "");
+  CHECK_EQUAL(run("S 5 IBM B 7 103.00000"),
+              "F 13 IBM 5 103.00000|F 14 IBM 2 104.00000|F 5 IBM 5 103.00000|F 5 IBM 2 104.00000");
+
+  // Sell stops crossed by one trade run highest stop first, FIFO within a price
+  CHECK_EQUAL(run("S 6 IBM S 1 95.00000 90.00000"), "");
+  CHECK_EQUAL(run("S 7 IBM S 1 96.00000 90.00000"), "");
+  CHECK_EQUAL(run("S 8 IBM S 1 96.00000 90.00000"), "");
+  CHECK_EQUAL(run("O 15 IBM B 3 94.00000"), "");
+  auto cascade = run("O 16 IBM S 1 94.00000");
+  CHECK_EQUAL(cascade, "F 15 IBM 1 94.00000|F 16 IBM 1 94.00000|"
+              "F 15 IBM 1 90.00000|F 7 IBM 1 90.00000|"
+              "F 15 IBM 1 90.00000|F 8 IBM 1 90.00000");
+  // Stop 6 rests as a limit order; mass cancel releases pending stops after the book
+  CHECK_EQUAL(run("S 9 IBM B 1 120.00000"), "");
+  auto released = run("C IBM");
+  CHECK_EQUAL(released, "X 6|X 14|X 9");
+  return true;
+}
+
+auto test_time_in_force() -> bool {
+  {
+    Action ioc("O 1 IBM B 10 100.00000 IOC");
+    CHECK_EQUAL(ioc.order.tif, TimeInForce::IOC);
+    Action fok("O 1 IBM B 10 100.00000 FOK");
+    CHECK_EQUAL(fok.order.tif, TimeInForce::FOK);
+    Action gtc("O 1 IBM B 10 100.00000");
+    CHECK_EQUAL(gtc.order.tif, TimeInForce::GTC);
+    try {
+      Action bad("O 1 IBM B 10 100.00000 DAY");
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+
+  MultiSymbolBook book;
+  auto results = [&book]() {
+    std::ostringstream os;
+    for (auto const & r : book.getResults()) {
+      os << r << "|";
+    }
+    return os.str();
+  };
+  auto place = [&book](std::string const & line) { book.add(Action(line).order); };
+  place("O 1 IBM S 10 100.00000");
+  place("O 2 IBM S 5 101.00000");
+  place("O 3 IBM S 7 103.00000");
+  auto const & sells = book.matcher("IBM")->sellLevels();
+  CHECK_EQUAL(sells.begin()->second.quantity, 10u);
+
+  // 15 are available up to 101: a FOK for 16 is killed without a trade
+  auto hash = book.hash();
+  place("O 4 IBM B 16 101.00000 FOK");
+  auto killed = results();
+  CHECK_EQUAL(killed, "X 4|");
+  CHECK_EQUAL(book.hash(), hash);
+  CHECK_EQUAL(book.order(4), nullptr);
+
+  place("O 5 IBM B 12 101.00000 FOK");
+  auto filled = results();
+  CHECK_EQUAL(filled, "F 1 IBM 10 101.00000|F 2 IBM 2 101.00000|F 5 IBM 12 101.00000|");
+  CHECK_EQUAL(sells.begin()->second.quantity, 3u);
+
+  // IOC fills what crosses and cancels the rest instead of resting it
+  place("O 6 IBM B 5 102.00000 IOC");
+  auto partial = results();
+  CHECK_EQUAL(partial, "F 2 IBM 3 102.00000|F 6 IBM 3 102.00000|X 6|");
+  place("O 7 IBM B 5 102.00000 IOC");
+  auto none = results();
+  CHECK_EQUAL(none, "X 7|");
+  CHECK_EQUAL(book.order(7), nullptr);
+
+  // Level totals follow cancels
+  place("O 8 IBM S 4 103.00000");
+  book.cancel(3);
+  CHECK_EQUAL(sells.begin()->second.quantity, 4u);
+  place("O 9 IBM B 4 103.00000 FOK");
+  auto exact = results();
+  CHECK_EQUAL(exact, "F 8 IBM 4 103.00000|F 9 IBM 4 103.00000|");
+  bool empty = sells.empty();
+  CHECK_EQUAL(empty, true);
+  return true;
+}
+
+auto test_delta_dump() -> bool {
+  {
+    Action all("D");
+    CHECK_EQUAL(all.type, ActionType::Delta);
+    Action ibm("D IBM");
+    CHECK_EQUAL(ibm.order.symbol, "IBM");
+  }
+  MultiSymbolBook book;
+  auto delta = [&book](Symbol const & symbol) {
+    book.printDelta(symbol);
+    std::ostringstream os;
+    for (auto const & r : book.getResults()) {
+      os << r << "|";
+    }
+    return os.str();
+  };
+  book.add(Order(1, "IBM", Side::Buy, 10, Price("99.00000")));
+  book.add(Order(2, "IBM", Side::Buy, 10, Price("99.00000")));
+  book.add(Order(3, "IBM", Side::Sell, 10, Price("101.00000")));
+  book.add(Order(4, "IBM", Side::Buy, 5, Price("98.00000")));
+  // The first dump reports the whole book
+  auto first = delta("IBM");
+  CHECK_EQUAL(first, "D 1 IBM 10 99.00000|D 2 IBM 10 99.00000|D 4 IBM 5 98.00000|D 3 IBM 10 101.00000|");
+  auto unchanged = delta("IBM");
+  CHECK_EQUAL(unchanged, "");
+
+  // A fill, a cancel, a new order in an old level and one in a new level
+  book.add(Order(5, "IBM", Side::Sell, 14, Price("99.00000")));
+  book.add(Order(6, "IBM", Side::Buy, 3, Price("98.00000")));
+  book.add(Order(7, "IBM", Side::Sell, 3, Price("102.00000")));
+  book.cancel(3);
+  auto changes = delta("IBM");
+  CHECK_EQUAL(changes, "D 1 IBM 0 99.00000|D 2 IBM 6 99.00000|D 6 IBM 3 98.00000|"
+              "D 3 IBM 0 101.00000|D 7 IBM 3 102.00000|");
+
+  // Cancelled and placed again between dumps: removed, then added at the back
+  book.cancel(2);
+  book.add(Order(2, "IBM", Side::Buy, 1, Price("98.00000")));
+  book.add(Order(8, "IBM", Side::Buy, 1, Price("97.00000")));
+  book.cancel(8);
+  auto moved = delta("IBM");
+  CHECK_EQUAL(moved, "D 2 IBM 0 99.00000|D 2 IBM 1 98.00000|");
+
+  // A whole-book dump covers symbols not dumped before; an emptied symbol is
+  // kept by the reclaim sweep until its removals are reported, and for good
+  // once it traded
+  book.setReclaimPolicy(1);
+  book.add(Order(9, "MSFT", Side::Sell, 1, Price("10.00000")));
+  book.cancelSymbol("IBM");
+  auto msft = delta("MSFT");
+  CHECK_EQUAL(msft, "D 9 MSFT 1 10.00000|");
+  book.print();
+  book.print();
+  bool kept = book.matcher("IBM") != nullptr;
+  CHECK_EQUAL(kept, true);
+  book.add(Order(10, "MSFT", Side::Sell, 2, Price("10.00000")));
+  book.printDelta("");
+  auto all = book.getResults();
+  CHECK_EQUAL(all.size(), 5u);
+  book.print();
+  book.print();
+  bool traded = book.matcher("IBM") != nullptr;
+  CHECK_EQUAL(traded, true);
+  return true;
+}
+
+auto test_action_batch() -> bool {
+  // The same random session one action at a time and in batches of several sizes
+  std::mt19937 gen(40);
+  std::vector<std::string> symbols{"IBM", "MSFT", "AAPL"};
+  std::vector<Action> actions;
+  for (int i = 1; i <= 3000; ++i) {
+    auto dice = gen() % 10;
+    auto symbol = symbols[gen() % symbols.size()];
+    if (dice < 6) {
+      actions.emplace_back("O " + std::to_string(i) + " " + symbol + (gen() % 2 ? " B " : " S ") +
+                           std::to_string(1 + gen() % 30) + " " + std::to_string(95 + gen() % 10) + ".00000" +
+                           std::array{"", "", " IOC", " FOK"}[gen() % 4]);
+    }
+    else if (dice < 9) {
+      actions.emplace_back("X " + std::to_string(1 + gen() % i));
+    }
+    else {
+      actions.emplace_back(std::array<std::string, 5>{"D", "P", "D " + symbol, "T " + symbol, "C " + symbol}[gen() % 5]);
+    }
+  }
+  auto run = [&](size_t batch_size) {
+    MultiSymbolBook book;
+    std::ostringstream os;
+    runBatch(book, actions, batch_size, [&](size_t i, std::vector<Result> const & results) {
+      os << i << ":";
+      for (auto const & r : results) {
+        os << r << "|";
+      }
+    });
+    return os.str();
+  };
+  auto reference = run(1);
+  for (size_t batch_size : {2, 16, 64, 5000}) {
+    auto batched = run(batch_size);
+    bool same = batched == reference;
+    CHECK_EQUAL(same, true);
+  }
+  return true;
+}
+
+auto test_paced_replay() -> bool {
+  {
+    std::istringstream capture("100 O 1 IBM B 10 100.00000\n\n250 X 1\n");
+    auto actions = readCapture(capture);
+    CHECK_EQUAL(actions.size(), 2u);
+    CHECK_EQUAL(actions[1].arrival_ns, 250u);
+    CHECK_EQUAL(actions[1].line, "X 1");
+    for (auto bad : {"O 1 IBM B 10 100.00000\n", "12x X 1\n", "200 X 1\n100 X 2\n"}) {
+      try {
+        std::istringstream in(bad);
+        readCapture(in);
+        return false;
+      } catch (std::invalid_argument const & e) {
+        // expected
+      }
+    }
+  }
+
+  // Two bursts of three lines 10ms apart, replayed as fast as possible
+  std::vector<TimedAction> actions{
+      {1'000, "O 1 IBM B 10 100.00000"}, {2'000, "O 2 IBM S 4 100.00000"}, {3'000, "X 3"},
+      {10'003'000, "O 3 MSFT S 5 50.00000"}, {10'004'000, "P"}, {10'500'000, "X 1"}};
+  MultiSymbolBook book;
+  std::ostringstream paced;
+  auto report = PacedReplay(0, 1'000'000).run(book, actions, paced);
+  CHECK_EQUAL(report.bursts.size(), 2u);
+  CHECK_EQUAL(report.bursts[1].first, 3u);
+  CHECK_EQUAL(report.bursts[0].span_ns, 2'000u);
+  CHECK_EQUAL(report.bursts[1].span_ns, 497'000u);
+  CHECK_EQUAL(report.bursts[0].latency.actions, 3u);
+  CHECK_EQUAL(report.all.actions, 6u);
+  bool ordered = report.all.p50 <= report.all.p99 && report.all.p99 <= report.all.max;
+  CHECK_EQUAL(ordered, true);
+
+  // The results are those of running the lines one by one
+  MultiSymbolBook reference;
+  std::ostringstream expected;
+  for (auto const & [_, line] : actions) {
+    try {
+      execute(reference, Action(line));
+      for (auto const & r : reference.getResults()) {
+        expected << r << '\n';
+      }
+    }
+    catch (std::exception const & e) {
+      expected << e.what() << '\n';
+    }
+  }
+  bool same = paced.str() == expected.str();
+  CHECK_EQUAL(same, true);
+  return true;
+}
+
+auto test_trade_stats() -> bool {
+  CHECK_EQUAL(Price("100.12345").ticks(), 10012345);
+  CHECK_EQUAL(Price::fromTicks(10012345), Price("100.12345"));
+  {
+    Action stats("T IBM");
+    CHECK_EQUAL(stats.type, ActionType::Stats);
+    CHECK_EQUAL(stats.order.symbol, "IBM");
+    try {
+      Action bad("T");
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+
+  MultiSymbolBook book;
+  book.setTradeBars(2, 2);
+  // Joins the results of T with '|'
+  auto stats = [&book](Symbol const & symbol) {
+    book.printStats(symbol);
+    std::ostringstream os;
+    for (auto const & r : book.getResults()) {
+      os << (os.tellp() ? "|" : "") << r;
+    }
+    return os.str();
+  };
+  auto ibm = stats("IBM");
+  CHECK_EQUAL(ibm, "T IBM 0 0");
+
+  book.add(Order(1, "IBM", Side::Sell, 10, Price("100.00000")));
+  book.add(Order(2, "IBM", Side::Sell, 10, Price("102.00000")));
+  book.add(Order(3, "IBM", Side::Buy, 4, Price("100.00000")));
+  book.add(Order(4, "IBM", Side::Buy, 8, Price("102.00000")));
+  book.add(Order(5, "IBM", Side::Buy, 1, Price("103.00000")));
+  book.add(Order(6, "MSFT", Side::Buy, 1, Price("10.00000")));
+  // 4 @ 100, 6 @ 102, 2 @ 102, 1 @ 103; the VWAP 1319 / 13 rounds to the tick
+  ibm = stats("IBM");
+  CHECK_EQUAL(ibm, "T IBM 13 4 100.00000 103.00000 100.00000 103.00000 101.46154|"
+              "B IBM 0 10 2 100.00000 102.00000 100.00000 102.00000 101.20000|"
+              "B IBM 1 3 2 102.00000 103.00000 102.00000 103.00000 102.33333");
+  CHECK_EQUAL(static_cast<int64_t>(book.tradeStats("IBM")->session().notional), 131900000);
+  auto msft = stats("MSFT");
+  CHECK_EQUAL(msft, "T MSFT 0 0");
+
+  // The ring keeps the last two bars
+  book.add(Order(7, "IBM", Side::Buy, 1, Price("103.00000")));
+  ibm = stats("IBM");
+  CHECK_EQUAL(ibm, "T IBM 14 5 100.00000 103.00000 100.00000 103.00000 101.57143|"
+              "B IBM 1 3 2 102.00000 103.00000 102.00000 103.00000 102.33333|"
+              "B IBM 2 1 1 103.00000 103.00000 103.00000 103.00000 103.00000");
+  return true;
+}
+
+auto test_symbol_reclaim() -> bool {
+  {
+    Action whole("M");
+    CHECK_EQUAL(whole.type, ActionType::Memory);
+    CHECK_EQUAL(whole.order.symbol, "");
+    Action ibm("M IBM");
+    CHECK_EQUAL(ibm.order.symbol, "IBM");
+  }
+
+  MultiSymbolBook book;
+  book.setReclaimPolicy(10);
+  for (OrderID id = 1; id <= 5; ++id) {
+    book.add(Order(id, "MSFT", Side::Buy, 1, Price("10.00000")));
+  }
+  for (OrderID id = 2; id <= 5; ++id) {
+    book.cancel(id);
+  }
+  auto msft = book.memoryUsage("MSFT");
+  CHECK_EQUAL(msft.orders, sizeof(void *) + sizeof(std::pair<OrderID const, Order>));
+  CHECK_EQUAL(msft.queues, 8 * sizeof(RestingOrder));
+  book.add(Order(6, "IBM", Side::Sell, 1, Price("10.00000")));
+  book.cancel(6);
+  CHECK_EQUAL(book.memoryUsage("IBM").levels, 0);
+  CHECK_EQUAL(book.symbolCount(), 2);
+  auto hash = book.hash();
+
+  // AAPL stays active while IBM and MSFT go idle
+  for (OrderID id = 7; id < 37; ++id) {
+    book.add(Order(id, "AAPL", Side::Buy, 1, Price("10.00000")));
+  }
+  CHECK_EQUAL(book.symbolCount(), 2);
+  CHECK_EQUAL(book.memoryUsage("IBM").orders, 0);
+  // MSFT still has an order: kept, with its queue shrunk to fit
+  CHECK_EQUAL(book.memoryUsage("MSFT").queues, sizeof(RestingOrder));
+  CHECK_EQUAL(book.hash(), hash + book.hash("AAPL"));
+
+  book.printMemory("");
+  CHECK_EQUAL(book.getResults().size(), 4);
+  CHECK_EQUAL(book.getResults()[1].value, 31 * msft.orders);
+  std::ostringstream os;
+  os << book.getResults()[0];
+  CHECK_EQUAL(os.str(), "M levels " + std::to_string(book.memoryUsage().levels));
+  book.printMemory("MSFT");
+  CHECK_EQUAL(book.getResults().size(), 3);
+
+  // A reclaimed symbol starts over
+  book.add(Order(6, "IBM", Side::Sell, 1, Price("10.00000")));
+  CHECK_EMPTY(book.getResults());
+  CHECK_EQUAL(book.symbolCount(), 3);
+  book.cancel(1);
+  CHECK_EQUAL(book.getResults()[0].type, ResultType::CancelConfirm);
+
+  // An empty symbol that traded keeps its last price and statistics: a stop
+  // placed after it went idle still triggers against the last trade
+  book.add(Order(40, "GOOG", Side::Buy, 2, Price("20.00000")));
+  book.add(Order(41, "GOOG", Side::Sell, 2, Price("20.00000")));
+  for (OrderID id = 42; id < 72; ++id) {
+    book.add(Order(id, "AAPL", Side::Buy, 1, Price("10.00000")));
+  }
+  auto stats = book.tradeStats("GOOG");
+  bool kept = stats != nullptr;
+  CHECK_EQUAL(kept, true);
+  CHECK_EQUAL(stats->session().trades, 1u);
+  book.add(Action("S 72 GOOG B 1 19.00000").order);
+  CHECK_EQUAL(book.getResults().size(), 1u);
+  CHECK_EQUAL(book.getResults()[0].type, ResultType::CancelConfirm);
+  return true;
+}
+
+auto test_huge_page_arena() -> bool {
+  BookArena memory(4 << 20);
+  if (memory.arena.backing() == PageBacking::None) {
+    std::cout << "Arena could not map any memory: " << memory.arena.error() << std::endl;
+    return false;
+  }
+  bool big_enough = memory.arena.capacity() >= (4 << 20);
+  CHECK_EQUAL(big_enough, true);
+  {
+    MultiSymbolBook book(memory.resource());
+    for (OrderID id = 1; id <= 1000; ++id) {
+      book.add(Order(id, id % 2 ? "IBM" : "MSFT", Side::Buy, 10, Price(100'000'000 + id % 7)));
+    }
+    book.add(Order(1001, "IBM", Side::Sell, 100, Price("99.00000")));
+    CHECK_EQUAL(book.getResults().size(), 11);
+    CHECK_EQUAL(memory.arena.overflow(), 0);
+    bool used_arena = memory.arena.used() > 0;
+    CHECK_EQUAL(used_arena, true);
+  }
+  // Freed blocks are reused by the next book
+  auto used = memory.arena.used();
+  {
+    MultiSymbolBook book(memory.resource());
+    book.add(Order(1, "IBM", Side::Buy, 10, Price("99.00000")));
+  }
+  CHECK_EQUAL(memory.arena.used(), used);
+
+  auto cpus = parseCpuList("0,2-3");
+  CHECK_EQUAL(cpus.size(), 3);
+  CHECK_EQUAL(cpus[2], 3);
+  for (auto bad : {"3-1", "x", "2-", "1a", "-1"}) {
+    try {
+      parseCpuList(bad);
+      return false;
+    } catch (std::invalid_argument const & e) {
+      // expected
+    }
+  }
+
+  // Pinned replay gives the same output, and the caller its CPUs back
+  std::vector<std::string> lines{"O 1 IBM B 10 99.00000", "O 2 MSFT S 5 10.00000",
+                                 "O 3 IBM S 4 98.00000", "P", "H"};
+  std::ostringstream sequential, pinned;
+  ParallelReplay::runSequential(lines, sequential);
+  auto caller_cpus = allowedCpus();
+  ParallelReplay(2, ThreadOptions{{caller_cpus.front()}}).run(lines, pinned);
+  CHECK_EQUAL(pinned.str(), sequential.str());
+  bool restored = allowedCpus() == caller_cpus;
+  CHECK_EQUAL(restored, true);
+  return true;
+}
+
+auto test_book_fork() -> bool {
+  // The same session on two books; the twin then plays the fork's actions for real
+  std::mt19937 gen(7);
+  std::vector<Symbol> symbols{"IBM", "MSFT"};
+  MultiSymbolBook live, twin;
+  auto randomOrder = [&](OrderID id) {
+    return Order(id, symbols[gen() % symbols.size()], gen() % 2 ? Side::Buy : Side::Sell,
+                 static_cast<Quantity>(1 + gen() % 20), Price(100'000'000 + 1000 * static_cast<int64_t>(gen() % 10)));
+  };
+  auto format = [](std::vector<Result> const & results) {
+    std::ostringstream os;
+    for (auto const & r : results) {
+      os << r << "|";
+    }
+    return os.str();
+  };
+  for (OrderID id = 1; id <= 300; ++id) {
+    auto order = randomOrder(id);
+    live.add(order);
+    twin.add(order);
+    if (gen() % 4 == 0) {
+      auto cancelled = 1 + gen() % id;
+      live.cancel(cancelled);
+      twin.cancel(cancelled);
+    }
+  }
+  auto hash = live.hash();
+
+  BookFork fork(live);
+  for (OrderID id = 250; id <= 600; ++id) {
+    if (gen() % 3 == 0) {
+      auto cancelled = 1 + gen() % id;
+      fork.cancel(cancelled);
+      twin.cancel(cancelled);
+    }
+    else {
+      auto order = randomOrder(id);
+      order.tif = std::array{TimeInForce::GTC, TimeInForce::GTC, TimeInForce::IOC, TimeInForce::FOK}[gen() % 4];
+      fork.add(order);
+      twin.add(order);
+    }
+    auto forked = format(fork.getResults());
+    CHECK_EQUAL(forked, format(twin.getResults()));
+  }
+  CHECK_EQUAL(live.hash(), hash);
+
+  // Only the named symbols, and only until the live book changes
+  BookFork ibm(live, {"IBM"});
+  ibm.add(Order(1000, "MSFT", Side::Buy, 1, Price("100.00000")));
+  CHECK_EQUAL(ibm.getResults()[0].error_message, "Symbol is not in the fork");
+  ibm.add(Order(1000, "IBM", Side::Buy, 1, Price("1.00000")));
+  CHECK_EMPTY(ibm.getResults());
+  Order stop(1001, "IBM", Side::Sell, 1, Price("1.00000"));
+  stop.type = OrderType::Stop;
+  ibm.add(stop);
+  CHECK_EQUAL(ibm.getResults()[0].error_message, "Stop orders are not simulated");
+  live.add(Order(1000, "MSFT", Side::Buy, 1, Price("1.00000")));
+  ibm.cancel(1000);
+  CHECK_EQUAL(ibm.getResults()[0].type, ResultType::CancelConfirm);
+  BookFork whole(live);
+  live.cancel(1000);
+  whole.cancel(1);
+  CHECK_EQUAL(whole.getResults()[0].error_message, "Fork is stale");
+  live.add(Order(1001, "IBM", Side::Buy, 1, Price("1.00000")));
+  ibm.cancel(1000);
+  CHECK_EQUAL(ibm.getResults()[0].error_message, "Fork is stale");
+
+  // Mass cancels that release nothing and sweeps that erase nothing leave
+  // even a whole-book fork fresh
+  MultiSymbolBook quiet;
+  quiet.add(Order(1, "IBM", Side::Buy, 1, Price("1.00000")));
+  BookFork fresh(quiet);
+  quiet.setReclaimPolicy(1);
+  quiet.cancelSymbol("MSFT");
+  quiet.cancelSide("IBM", Side::Sell);
+  quiet.printHash("");
+  quiet.printHash("");
+  CHECK_EQUAL(fresh.stale(), false);
+  quiet.cancelSide("IBM", Side::Buy);
+  CHECK_EQUAL(fresh.stale(), true);
+  return true;
+}
+
+auto test_trade_tape() -> bool {
+  CHECK_EQUAL(tape::unzigzag(tape::zigzag(-3)), -3);
+  auto parsed = parseTapeColumns("qty,seq");
+  bool qty_seq = parsed == (tapeColumn(TapeColumn::Quantity) | tapeColumn(TapeColumn::Seq));
+  CHECK_EQUAL(qty_seq, true);
+
+  // Random crossing flow on a few symbols; every fill of a resting order is a trade
+  auto record_session = [](std::string const & path, std::vector<Trade> & expected) {
+    TradeTape tape(path, 5, 8);  // small blocks and a ring that fills up
+    MultiSymbolBook book;
+    book.setTradeTape(&tape);
+    std::mt19937 gen(37);
+    std::vector<Symbol> const symbols{"IBM", "MSFT", "AAPL"};
+    for (OrderID id = 1; id <= 600; ++id) {
+      auto side = gen() % 2 ? Side::Buy : Side::Sell;
+      auto price = Price::fromTicks(9'990'000 + static_cast<int64_t>(gen() % 20) * 1000);
+      Order order(id, symbols[gen() % symbols.size()], side, static_cast<Quantity>(1 + gen() % 50), price);
+      book.add(order);
+      for (auto const & r : book.getResults()) {
+        if (r.type == ResultType::FillConfirm && r.order_id != id) {
+          expected.push_back(Trade{expected.size() + 1, r.symbol, r.order_id, id, r.quantity, r.price});
+        }
+      }
+    }
+    return tape.trades();
+  };
+  auto path = (std::filesystem::temp_directory_path() / "run_tests_trade_tape.ttb").string();
+  std::vector<Trade> expected;
+  auto recorded = record_session(path, expected);
+  CHECK_EQUAL(recorded, expected.size());
+
+  // The same session writes the same bytes
+  auto again = path + ".again";
+  std::vector<Trade> ignored;
+  record_session(again, ignored);
+  auto contents = [](std::string const & p) {
+    std::ifstream in(p, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+  };
+  bool identical = contents(path) == contents(again);
+  CHECK_EQUAL(identical, true);
+  std::filesystem::remove(again);
+
+  TapeReader reader(path);
+  // Reads back the trades of symbol in [from, to] with the given columns
+  auto scan = [&](Symbol const & symbol, uint64_t from, uint64_t to, TapeColumns columns) {
+    std::vector<Trade> trades;
+    reader.scan(symbol, from, to, columns, [&](Trade const & t) { trades.push_back(t); });
+    return trades;
+  };
+  auto same = [](Trade const & a, Trade const & b, TapeColumns columns) {
+    return a.symbol == b.symbol &&
+        (!(columns & tapeColumn(TapeColumn::Seq)) || a.seq == b.seq) &&
+        (!(columns & tapeColumn(TapeColumn::Maker)) || a.maker == b.maker) &&
+        (!(columns & tapeColumn(TapeColumn::Taker)) || a.taker == b.taker) &&
+        (!(columns & tapeColumn(TapeColumn::Quantity)) || a.quantity == b.quantity) &&
+        (!(columns & tapeColumn(TapeColumn::Price)) || a.price == b.price);
+  };
+  auto const price_only = tapeColumn(TapeColumn::Price);
+  for (auto columns : {ALL_TAPE_COLUMNS, price_only}) {
+    for (auto [from, to] : {std::pair<uint64_t, uint64_t>{0, ~0ull}, {17, 83}, {expected.size(), expected.size()}}) {
+      auto trades = scan("MSFT", from, to, columns);
+      size_t n = 0;
+      for (auto const & e : expected) {
+        if (e.symbol == "MSFT" && from <= e.seq && e.seq <= to) {
+          bool match = n < trades.size() && same(trades[n], e, columns);
+          CHECK_EQUAL(match, true);
+          ++n;
+        }
+      }
+      CHECK_EQUAL(trades.size(), n);
+    }
+  }
+  auto none = scan("GOOG", 0, ~0ull, ALL_TAPE_COLUMNS);
+  CHECK_EMPTY(none);
+  std::filesystem::remove(path);
+  return true;
+}
+
+auto test_parallel_replay() -> bool {
+  // Random session over a few symbols. Order ids are drawn from a small range
+  // so they get reused across symbols, duplicated and cancelled before being placed
+  std::mt19937 gen(42);
+  std::vector<std::string> symbols{"IBM", "AAPL", "MSFT", "GOOG", "TSLA"};
+  std::vector<std::string> lines;
+  for (int i = 0; i < 5000; ++i) {
+    auto dice = gen() % 100;
+    auto id = std::to_string(gen() % 400);
+    if (dice < 70) {
+      auto price = std::to_string(95 + gen() % 10) + ".00000";
+      lines.push_back("O " + id + " " + symbols[gen() % symbols.size()] + " " +
+                      (gen() % 2 ? "B " : "S ") + std::to_string(1 + gen() % 20) + " " + price +
+                      std::array{"", "", "", " IOC", " FOK"}[gen() % 5]);
+    }
+    else if (dice < 75) {
+      auto stop = std::to_string(95 + gen() % 10) + ".00000";
+      auto limit = gen() % 2 ? " " + std::to_string(95 + gen() % 10) + ".00000" : "";
+      lines.push_back("S " + id + " " + symbols[gen() % symbols.size()] + " " +
+                      (gen() % 2 ? "B " : "S ") + std::to_string(1 + gen() % 20) + " " + stop + limit);
+    }
+    else if (dice < 95) {
+      lines.push_back("X " + id);
+    }
+    else if (dice < 96) {
+      lines.push_back("P");
+    }
+    else if (dice < 97) {
+      auto kind = gen() % 7;
+      lines.push_back(kind == 0 ? "H" : kind == 4 ? "D" : kind == 6 ? "M" :
+                      std::string(kind == 1 ? "H " : kind == 2 ? "T " : kind == 3 ? "M " : "D ") +
+                      symbols[gen() % symbols.size()]);
+    }
+    else if (dice < 98) {
+      auto scope = gen() % 3;
+      lines.push_back(scope == 0 ? "C" : "C " + symbols[gen() % symbols.size()] + (scope == 1 ? "" : " B"));
+    }
+    else {
+      lines.push_back("Q " + id);
+    }
+  }
+
+  // A whole-book M reports the partitions' own book overhead, the one line
+  // allowed to differ from the single book
+  auto without_book_usage = [](std::string const & text) {
+    std::istringstream in(text);
+    std::string kept;
+    for (std::string line; std::getline(in, line);) {
+      if (!line.starts_with("M book ")) {
+        kept += line + '\n';
+      }
+    }
+    return kept;
+  };
+  std::ostringstream out_sequential;
+  ParallelReplay::runSequential(lines, out_sequential);
+  auto sequential = without_book_usage(out_sequential.str());
+  for (size_t nthreads : {1, 2, 3, 8}) {
+    std::ostringstream out_parallel;
+    ParallelReplay(nthreads).run(lines, out_parallel);
+    auto parallel = without_book_usage(out_parallel.str());
+    CHECK_EQUAL(parallel.size(), sequential.size());
+    if (parallel != sequential) {
+      std::cout << "Parallel replay with " << nthreads << " threads differs from sequential" << std::endl;
+      return false;
+    }
+  }
+
+  // P of a partitioned book is merged by symbol
+  std::ostringstream out;
+  ParallelReplay(4).run({"O 1 MSFT B 10 100.00000", "O 2 IBM S 5 101.00000",
+                         "O 3 IBM B 5 99.00000", "X 7", "P"}, out);
+  CHECK_EQUAL(out.str(), std::string("E 7 Order does not exist\n"
+                                     "P 3 IBM 5 99.00000\n"
+                                     "P 2 IBM 5 101.00000\n"
+                                     "P 1 MSFT 10 100.00000\n"));
+  return true;
+}
+
 template <typename F>
 void run_test(F f, std::string const & name) {
   if (!f()) {
@@ -357,7 +1347,22 @@ auto main(int , char *[]) -> int {
   run_test(test_highest_bidder, "Highest bidder");
   run_test(test_cancellation, "Symbol book cancel");
   run_test(test_action, "Action");
+  run_test(test_field_decode, "Field decode");
   run_test(test_multi_symbol_book, "Multi symbol book");
+  run_test(test_book_entries, "Book entries");
+  run_test(test_mass_cancel, "Mass cancel");
+  run_test(test_book_hash, "Book hash");
+  run_test(test_stop_orders, "Stop orders");
+  run_test(test_time_in_force, "Time in force");
+  run_test(test_delta_dump, "Delta dump");
+  run_test(test_action_batch, "Action batch");
+  run_test(test_paced_replay, "Paced replay");
+  run_test(test_trade_stats, "Trade stats");
+  run_test(test_symbol_reclaim, "Symbol reclaim");
+  run_test(test_huge_page_arena, "Huge page arena");
+  run_test(test_book_fork, "Book fork");
+  run_test(test_trade_tape, "Trade tape");
+  run_test(test_parallel_replay, "Parallel replay");
 
   return 0;
 }
@@ -0,0 +1,58 @@
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "TradeTape.hpp"
+
+/*
+** Prints the trades of one symbol from a trade tape written by app --tape.
+** usage: tape FILE SYMBOL [FROM [TO]] [--columns LIST]
+** FROM and TO bound the sequence numbers (inclusive). LIST names the columns
+** to print, in file order, from seq,maker,taker,qty,price (all by default);
+** only those columns are read from the tape.
+*/
+auto main(int argc, char *argv[]) -> int
+{
+  std::vector<std::string> args;
+  hft::TapeColumns columns = hft::ALL_TAPE_COLUMNS;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      if (!std::strcmp(argv[i], "--columns") && i + 1 < argc) {
+        columns = hft::parseTapeColumns(argv[++i]);
+      }
+      else {
+        args.push_back(argv[i]);
+      }
+    }
+    if (args.size() < 2 || args.size() > 4) {
+      std::cerr << "usage: tape FILE SYMBOL [FROM [TO]] [--columns LIST]" << std::endl;
+      return EXIT_FAILURE;
+    }
+    uint64_t from = args.size() > 2 ? std::stoull(args[2]) : 0;
+    uint64_t to = args.size() > 3 ? std::stoull(args[3]) : std::numeric_limits<uint64_t>::max();
+
+    std::ios::sync_with_stdio(false);
+    hft::TapeReader reader(args[0]);
+    reader.scan(hft::Symbol(args[1]), from, to, columns, [&](hft::Trade const & trade) {
+      char const * sep = "";
+      auto field = [&](hft::TapeColumn column, auto const & value) {
+        if (columns & hft::tapeColumn(column)) {
+          std::cout << sep << value;
+          sep = " ";
+        }
+      };
+      field(hft::TapeColumn::Seq, trade.seq);
+      field(hft::TapeColumn::Maker, trade.maker);
+      field(hft::TapeColumn::Taker, trade.taker);
+      field(hft::TapeColumn::Quantity, trade.quantity);
+      field(hft::TapeColumn::Price, trade.price);
+      std::cout << '\n';
+    });
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}